@@ -60,9 +60,71 @@ def add_hostname_routine(sA):
   sA.append("#include <sys/utsname.h>")
   sA.append("#include <sys/types.h>")
   sA.append("#include <sys/socket.h>")
+  sA.append("#include <sys/stat.h>")
   sA.append("#include <netdb.h>")
   sA.append("#include <string.h>")
+  sA.append("#include <fcntl.h>")
+  sA.append("#include <time.h>")
   sA.append("#include \"xalt_obfuscate.h\"")
+  sA.append("#include \"xalt_config.h\"")
+  sA.append("")
+  sA.append("#define SYSHOST_TTL 3600")
+  sA.append("")
+  sA.append("/* The canonical name of the node is kept in XALT_TMPDIR for")
+  sA.append(" * XALT_SYSHOST_TTL seconds (0 => never) so that not every program")
+  sA.append(" * calls getaddrinfo().  The file written by root is used by everyone;")
+  sA.append(" * other users read and write their own. */")
+  sA.append("static void syshost_cache_name(char* fn, size_t sz, uid_t uid)")
+  sA.append("{")
+  sA.append("  if (uid == 0)")
+  sA.append("    snprintf(fn, sz, \"%s/XALT_syshost\", XALT_TMPDIR);")
+  sA.append("  else")
+  sA.append("    snprintf(fn, sz, \"%s/XALT_syshost_%u\", XALT_TMPDIR, (unsigned int) uid);")
+  sA.append("}")
+  sA.append("")
+  sA.append("static char* syshost_cache_read(const char* nodename, uid_t uid, long ttl)")
+  sA.append("{")
+  sA.append("  char        fn[1024];")
+  sA.append("  char        buf[2048];")
+  sA.append("  struct stat st;")
+  sA.append("  ssize_t     n   = -1;")
+  sA.append("  size_t      len = strlen(nodename);")
+  sA.append("  char*       nl;")
+  sA.append("  int         fd;")
+  sA.append("")
+  sA.append("  syshost_cache_name(fn, sizeof(fn), uid);")
+  sA.append("  fd = open(fn, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);")
+  sA.append("  if (fd < 0)")
+  sA.append("    return NULL;")
+  sA.append("  if (fstat(fd, &st) == 0 && st.st_uid == uid && (st.st_mode & 022) == 0 &&")
+  sA.append("      time(NULL) - st.st_mtime < ttl)")
+  sA.append("    n = read(fd, buf, sizeof(buf) - 1);")
+  sA.append("  close(fd);")
+  sA.append("  if (n <= 0)")
+  sA.append("    return NULL;")
+  sA.append("")
+  sA.append("  /* The file holds the nodename and its canonical name, one per line. */")
+  sA.append("  buf[n] = '\\0';")
+  sA.append("  if (strncmp(buf, nodename, len) != 0 || buf[len] != '\\n' || (nl = strchr(&buf[len+1], '\\n')) == NULL)")
+  sA.append("    return NULL;")
+  sA.append("  *nl = '\\0';")
+  sA.append("  return strdup(&buf[len+1]);")
+  sA.append("}")
+  sA.append("")
+  sA.append("static void syshost_cache_write(const char* nodename, const char* name)")
+  sA.append("{")
+  sA.append("  char fn[1024];")
+  sA.append("  char tmpFn[1100];")
+  sA.append("  int  fd;")
+  sA.append("")
+  sA.append("  syshost_cache_name(fn, sizeof(fn), getuid());")
+  sA.append("  snprintf(tmpFn, sizeof(tmpFn), \"%s.%d\", fn, (int) getpid());")
+  sA.append("  fd = open(tmpFn, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);")
+  sA.append("  if (fd < 0)")
+  sA.append("    return;")
+  sA.append("  if (dprintf(fd, \"%s\\n%s\\n\", nodename, name) < 0 || close(fd) != 0 || rename(tmpFn, fn) != 0)")
+  sA.append("    unlink(tmpFn);")
+  sA.append("}")
   sA.append("")
   sA.append("char * hostname()")
   sA.append("{")
@@ -70,8 +132,14 @@ def add_hostname_routine(sA):
   sA.append("  struct addrinfo hints, *info;")
   sA.append("  int gai_result;")
   sA.append("  struct utsname u;")
+  sA.append("  const char* v   = getenv(\"XALT_SYSHOST_TTL\");")
+  sA.append("  long        ttl = v ? atol(v) : SYSHOST_TTL;")
   sA.append("")
   sA.append("  uname(&u);")
+  sA.append("  if (ttl > 0 && ((my_hostname = syshost_cache_read(u.nodename, 0, ttl)) != NULL ||")
+  sA.append("                  (getuid() != 0 && (my_hostname = syshost_cache_read(u.nodename, getuid(), ttl)) != NULL)))")
+  sA.append("    return my_hostname;")
+  sA.append("")
   sA.append("  memset(&hints, 0, sizeof hints);")
   sA.append("  hints.ai_family = AF_UNSPEC; /*either IPV4 or IPV6*/")
   sA.append("  hints.ai_socktype = SOCK_STREAM;")
@@ -85,6 +153,8 @@ def add_hostname_routine(sA):
   sA.append("")
   sA.append("  my_hostname = strdup(info->ai_canonname);")
   sA.append("  freeaddrinfo(info);")
+  sA.append("  if (ttl > 0)")
+  sA.append("    syshost_cache_write(u.nodename, my_hostname);")
   sA.append("  return my_hostname;")
   sA.append("}")
 
@@ -52,6 +52,10 @@ def __FILE__():
 
 #print ("file: '%s', line: %d" % (__FILE__(), __LINE__()), file=sys.stderr)
 
+# How long (in seconds) a run record identified by its watermark may wait
+# for its link record to be loaded before it is stored without a hash_id.
+LINK_WAIT = 7*24*3600
+
 def convertToTinyInt(s):
   """
   Convert to string to int.  Protect against bad input.
@@ -244,6 +248,11 @@ class XALTdb(object):
         if (hash_id == "unknown"):
           continue
 
+        # An ELF build-id is stored as "b:" followed by its first 38 hex
+        # digits so that it cannot be mistaken for a sha1sum.
+        if (len(entryA) > 2 and entryA[2] == "buildid"):
+          hash_id = ("b:" + hash_id)[:40]
+
         query = "SELECT obj_id, object_path FROM xalt_object WHERE hash_id=%s AND object_path=%s AND syshost=%s"
           
         cursor.execute(query,(hash_id, object_path[:1024], syshost[:64]))
@@ -274,11 +283,14 @@ class XALTdb(object):
       print ("load_xalt_objects(): Error %d: %s" % (e.args[0], e.args[1]),file=sys.stderr)
       sys.exit (1)
 
-  def run_to_db(self, reverseMapT, u2acctT, runT):
+  def run_to_db(self, reverseMapT, u2acctT, runT, deferOK = False):
     """
     Store the "run" data into the database.
     @param: reverseMapT: The map between directories and modules
     @param: runT:        The run data stored in a table
+    @param: deferOK:     If true, a run whose executable was identified by
+                         its watermark is not stored until its link record is.
+    @return: True if stored, False if already there, None if deferred.
     """
     
     query = ""
@@ -318,7 +330,7 @@ class XALTdb(object):
         v = XALT_Stack.pop()
         carp("SUBMIT_HOST",v)
 
-        return
+        return stored
       else:
         #print("not found")
         moduleName    = obj2module(runT['userT']['exec_path'], reverseMapT)
@@ -333,10 +345,29 @@ class XALTdb(object):
           account = u2acctT.get(user,"unknown")
 
 
+        # The executable was not hashed because its watermark proves it is
+        # the one XALT linked: use the sha1sum from its link record.  If
+        # that has not been loaded yet then let the caller keep the run
+        # record for a later pass, but only for LINK_WAIT seconds.
+        hash_id       = runT['hash_id']
+        if (runT.get('hash_kind') == "watermark"):
+          query   = "SELECT hash_id FROM xalt_link WHERE uuid=%s"
+          cursor.execute(query, [uuid])
+          if (cursor.rowcount > 0):
+            hash_id = cursor.fetchone()[0]
+          elif (deferOK and time.time() - float(runT['userDT']['start_time']) < LINK_WAIT):
+            conn.query("ROLLBACK")
+            conn.close()
+            v = XALT_Stack.pop()
+            carp("SUBMIT_HOST",v)
+            return None
+          else:
+            hash_id = "unknown"
+
         startTime     = "%.f" % float(runT['userDT']['start_time'])
         query  = "INSERT INTO xalt_run VALUES (NULL, %s,%s,%s, %s,%s,%s, %s,%s,%s, %s,%s,%s, %s,%s,%s, %s,%s,%s, %s,%s,%s, %s,%s,COMPRESS(%s))"
         cursor.execute(query, (runT['userT']['job_id'],      runT['userT']['run_uuid'],    dateTimeStr,
-                               runT['userT']['syshost'],     uuid,                         runT['hash_id'],
+                               runT['userT']['syshost'],     uuid,                         hash_id,
                                account,                      runT['userT']['exec_type'],   startTime,
                                endTime,                      runTime,                      probability,
                                runT['userDT']['num_cores'],  runT['userDT']['num_nodes'],  num_threads,
@@ -409,13 +440,15 @@ class XALTdb(object):
       if (cursor.rowcount > 0):
         row         = cursor.fetchone()
         run_id      = int(row[0])
-        program     = pkgT['program'][:12]
-        pkg_name    = pkgT['package_name'][:64]
-        pkg_version = pkgT['package_version'][:32]
-        pkg_path    = pkgT['package_path'][:10]
-        
+
+        # A record from libxalt_pkg.so holds all the packages of a run in pkgA.
         query  = "INSERT into xalt_pkg VALUES(NULL,%s,%s,%s,%s,%s)"
-        cursor.execute(query,(run_id, program, pkg_name, pkg_version, pkg_path))
+        for pT in pkgT.get('pkgA', [pkgT]):
+          program     = pT['program'][:12]
+          pkg_name    = pT['package_name'][:64]
+          pkg_version = pT['package_version'][:32]
+          pkg_path    = pT['package_path'][:10]
+          cursor.execute(query,(run_id, program, pkg_name, pkg_version, pkg_path))
         
       v = XALT_Stack.pop()
       carp("SYSHOST",v)
@@ -44,6 +44,8 @@ from xalt_util     import *
 from xalt_global   import *
 from progressBar   import ProgressBar
 from Rmap_XALT     import Rmap
+from xalt_record_format import load_record
+from xalt_spool         import read_segment, spool_segments
 import warnings, getent
 warnings.filterwarnings("ignore", "Unknown table.*")
 
@@ -109,12 +111,12 @@ def link_json_to_db(xalt, listFn, reverseMapT, deleteFlg, linkFnA):
       XALT_Stack.push("fn: "+fn)   # push fn
 
       try:
-        f     = open(fn,"r")
+        f     = open(fn,"rb")
       except FileNotFoundError:
         continue
   
       try:
-        linkT = json.loads(f.read())
+        linkT = load_record(f.read())
       except:  
         f.close()
         v = XALT_Stack.pop()
@@ -161,12 +163,12 @@ def pkg_json_to_db(xalt, listFn, syshost, deleteFlg, pkgFnA):
       XALT_Stack.push("fn: "+fn)   # push fn
 
       try:
-        f     = open(fn,"r")
+        f     = open(fn,"rb")
       except FileNotFoundError:
         continue
   
       try:
-        pkgT = json.loads(f.read())
+        pkgT = load_record(f.read())
       except:  
         f.close()
         v = XALT_Stack.pop()
@@ -175,7 +177,7 @@ def pkg_json_to_db(xalt, listFn, syshost, deleteFlg, pkgFnA):
 
       f.close()
       xalt.pkg_to_db(syshost, pkgT)
-      num  += 1
+      num  += len(pkgT.get('pkgA', [pkgT]))
       try:
         if (deleteFlg):
           os.remove(fn)
@@ -213,12 +215,12 @@ def run_json_to_db(xalt, listFn, reverseMapT, u2acctT, deleteFlg, runFnA):
         sys.stderr.write(fn+"\n")
       XALT_Stack.push("fn: "+fn)
       try:
-        f      = open(fn,"r")
+        f      = open(fn,"rb")
       except FileNotFoundError:
         continue
       
       try:
-        runT   = json.loads(f.read())
+        runT   = load_record(f.read())
       except:
         f.close()
         v = XALT_Stack.pop()
@@ -226,7 +228,13 @@ def run_json_to_db(xalt, listFn, reverseMapT, u2acctT, deleteFlg, runFnA):
         continue
       f.close()
 
-      stored = xalt.run_to_db(reverseMapT, u2acctT, runT)
+      # A run waiting for its link record is left for the next pass.
+      stored = xalt.run_to_db(reverseMapT, u2acctT, runT, deferOK = True)
+      if (stored is None):
+        v = XALT_Stack.pop()
+        carp("fn",v)
+        continue
+
       try:
         if (deleteFlg):
           os.remove(fn)
@@ -245,6 +253,62 @@ def run_json_to_db(xalt, listFn, reverseMapT, u2acctT, deleteFlg, runFnA):
     sys.exit (1)
   return num
 
+def spool_to_db(xalt, listFn, reverseMapT, u2acctT, syshost, deleteFlg, segFnA, countT):
+  """
+  Reads in each sealed spool segment and sends its link, run and pkg
+  records to be written to DB.
+
+  @param xalt:        An XALTdb object.
+  @param listFn:      A flag that causes the name of the file to be written to stderr.
+  @param reverseMapT: The Reverse Map Table.
+  @param u2acctT:     The map for user to default account string
+  @param syshost:     The name of the cluster being processed.
+  @param deleteFlg:   A flag that says to delete segments after processing.
+  @param segFnA:      An array of segment file names
+  @param countT:      The counts of link, run and pkg records stored.
+
+  """
+  try:
+    for fn in segFnA:
+      if (listFn):
+        sys.stderr.write(fn+"\n")
+      XALT_Stack.push("fn: "+fn)
+
+      try:
+        recA = list(read_segment(fn))
+      except FileNotFoundError:
+        XALT_Stack.pop()
+        continue
+
+      for kind, payload in recA:
+        try:
+          recT = load_record(payload)
+        except:
+          continue
+        if (kind == "link"):
+          xalt.link_to_db(reverseMapT, recT)
+          countT['lnk'] += 1
+        elif (kind == "run"):
+          if (xalt.run_to_db(reverseMapT, u2acctT, recT)):
+            countT['run'] += 1
+        elif (kind == "pkg"):
+          xalt.pkg_to_db(syshost, recT)
+          countT['pkg'] += len(recT.get('pkgA', [recT]))
+
+      try:
+        if (deleteFlg):
+          os.remove(fn)
+      except:
+        pass
+
+      v = XALT_Stack.pop()
+      carp("fn",v)
+
+  except Exception as e:
+    print(XALT_Stack.contents())
+    print ("spool_to_db(): Error:",e)
+    sys.exit (1)
+
 def passwd_generator():
   """
   This generator walks the /etc/passwd file and returns the next
@@ -285,6 +349,26 @@ def build_resultDir(hdir, transmission, kind):
 
   return os.path.join(prefix,tail)
 
+def build_spoolDir(hdir):
+  """
+  Where the spool transmission writes its segments: XALT_SPOOL_DIR or
+  "spool" next to the files of the file transmission.
+  """
+  spoolDir = os.environ.get("XALT_SPOOL_DIR","@xalt_spool_dir@")
+  if (spoolDir):
+    return spoolDir
+  return os.path.join(build_resultDir(hdir, "file", ""), "spool")
+
+def record_files(xaltDir, kind, syshost):
+  """
+  Find the records of kind in xaltDir: JSON (*.json) or binary (*.xbin)
+  and possibly compressed (*.json.zst, ...).
+  """
+  fnA = []
+  for ext in ("json", "xbin", "json.*", "xbin.*"):
+    fnA += files_in_tree(xaltDir, "*/" + kind + "." + syshost + ".*." + ext)
+  return fnA
+
 def store_json_files(homeDir, transmission, xalt, rmapT, u2acctT, args, countT):
 
   xaltDir = build_resultDir(homeDir, transmission, "link")
@@ -292,7 +376,7 @@ def store_json_files(homeDir, transmission, xalt, rmapT, u2acctT, args, countT):
 
   if (os.path.isdir(xaltDir)):
     XALT_Stack.push("link_json_to_db()")
-    linkFnA         = files_in_tree(xaltDir, "*/link." + args.syshost + ".*.json")
+    linkFnA         = record_files(xaltDir, "link", args.syshost)
     for fn in linkFnA:
       print(fn)
     countT['lnk']  += link_json_to_db(xalt, args.listFn, rmapT, args.delete, linkFnA)
@@ -303,7 +387,7 @@ def store_json_files(homeDir, transmission, xalt, rmapT, u2acctT, args, countT):
   XALT_Stack.push("Directory: " + xaltDir)
   if (os.path.isdir(xaltDir)):
     XALT_Stack.push("run_json_to_db()")
-    runFnA         = files_in_tree(xaltDir, "*/run." + args.syshost + ".*.json") 
+    runFnA         = record_files(xaltDir, "run", args.syshost)
     countT['run'] += run_json_to_db(xalt, args.listFn, rmapT, u2acctT, args.delete, runFnA)
     XALT_Stack.pop()
   XALT_Stack.pop()
@@ -312,10 +396,21 @@ def store_json_files(homeDir, transmission, xalt, rmapT, u2acctT, args, countT):
   XALT_Stack.push("Directory: " + xaltDir)
   if (os.path.isdir(xaltDir)):
     XALT_Stack.push("pkg_json_to_db()")
-    pkgFnA         = files_in_tree(xaltDir, "*/pkg." + args.syshost + ".*.json") 
+    pkgFnA         = record_files(xaltDir, "pkg", args.syshost)
     countT['pkg'] += pkg_json_to_db(xalt, args.listFn, args.syshost, args.delete, pkgFnA)
     XALT_Stack.pop()
   XALT_Stack.pop()
+
+  # A shared XALT_SPOOL_DIR is read once from main().
+  if (homeDir and os.environ.get("XALT_SPOOL_DIR","@xalt_spool_dir@")):
+    return
+
+  spoolDir = build_spoolDir(homeDir)
+  if (os.path.isdir(spoolDir)):
+    XALT_Stack.push("spool_to_db()")
+    segFnA = spool_segments(spoolDir, args.syshost)
+    spool_to_db(xalt, args.listFn, rmapT, u2acctT, args.syshost, args.delete, segFnA, countT)
+    XALT_Stack.pop()
   
 
 
@@ -371,6 +466,11 @@ def main():
   if (xalt_file_prefix == "USE_HOME"):
     for user, homeDir in passwd_generator():
       store_json_files(homeDir, transmission, xalt, rmapT, u2acctT, args, countT)
+
+    spoolDir = os.environ.get("XALT_SPOOL_DIR","@xalt_spool_dir@")
+    if (spoolDir and os.path.isdir(spoolDir)):
+      segFnA = spool_segments(spoolDir, args.syshost)
+      spool_to_db(xalt, args.listFn, rmapT, u2acctT, args.syshost, args.delete, segFnA, countT)
   else:
     store_json_files("", transmission, xalt, rmapT, u2acctT, args, countT)
 
@@ -33,6 +33,8 @@ XALT_Stack              = Stack()
 # XALT_TRANSMISSION_STYLE:  Controls where the json data is sent:
 #                           "file"     : writes a file ~/.xalt.d
 #                           "syslog"   : writes data to syslog
+#                           "spool"    : appends to segment files
+#                           "socket"   : sends to a local agent
 #                           "directdb" : Calls db directly
 #                           "broker"   : HTTP post to send syslog-like msg
 #------------------------------------------------------------------------
@@ -52,3 +54,10 @@ XALT_BROKER_URI    = os.environ.get("XALT_BROKER_URI", "@broker_uri@")
 
 XALT_ETC_DIR            = os.environ.get("XALT_ETC_DIR","@etc_dir@")
 XALT_TRACING            = os.environ.get("XALT_TRACING")
+
+#------------------------------------------------------------------------
+# XALT_ZSTD_DICT:  The zstd dictionary that records were compressed
+#                  with (XALT_COMPRESSION=zstd), if any.
+#------------------------------------------------------------------------
+
+XALT_ZSTD_DICT          = os.environ.get("XALT_ZSTD_DICT","@xalt_zstd_dict@")
@@ -0,0 +1,189 @@
+#-----------------------------------------------------------------------
+# XALT: A tool that tracks users jobs and environments on a cluster.
+# Copyright (C) 2013-2014 University of Texas at Austin
+# Copyright (C) 2013-2014 University of Tennessee
+#
+# This library is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as
+# published by the Free Software Foundation; either version 2.1 of
+# the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Lesser  General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free
+# Software Foundation, Inc., 59 Temple Place, Suite 330,
+# Boston, MA 02111-1307 USA
+#-----------------------------------------------------------------------
+from __future__  import print_function
+import json, os, subprocess, sys, zlib
+from xalt_global import XALT_ZSTD_DICT
+
+# Reads the records that XALT writes with XALT_RECORD_FORMAT=binary.
+# The format is described in src/binRecord.h.  Records can also be
+# compressed with zlib, zstd or lz4 (XALT_COMPRESSION); the codec is
+# found from the first bytes.
+
+MAGIC      = b"XALTBIN1"
+ZSTD_MAGIC = b"\x28\xb5\x2f\xfd"
+LZ4_MAGIC  = b"\x04\x22\x4d\x18"
+
+# python2 has no surrogatepass error handler; its utf-8 codec lets
+# surrogates through anyway.
+SURROGATES = "surrogatepass" if sys.version_info[0] >= 3 else "strict"
+
+def is_binary_record(data):
+  """
+  Return True if data (bytes) is a binary XALT record.
+  """
+  return data[:len(MAGIC)] == MAGIC
+
+def is_compressed(data):
+  """
+  Return True if data (bytes) starts with a zstd or lz4 frame or a zlib header.
+  """
+  return data[:4] == ZSTD_MAGIC or data[:4] == LZ4_MAGIC or data[:1] == b"\x78"
+
+def run_filter(cmd, data):
+  """
+  Run cmd with data on its stdin and return its stdout.
+  """
+  proc     = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+  out, err = proc.communicate(data)
+  if (proc.returncode != 0):
+    raise subprocess.CalledProcessError(proc.returncode, cmd)
+  return out
+
+def decompress(data):
+  """
+  Decompress a record compressed by XALT with any of its codecs.  The
+  zstandard and lz4 modules are used when they are installed, the zstd
+  and lz4 programs otherwise.
+  @param data: the compressed record as bytes.
+  """
+  dictFn = XALT_ZSTD_DICT
+  if (not (dictFn and os.path.isfile(dictFn))):
+    dictFn = None
+
+  if (data[:4] == ZSTD_MAGIC):
+    try:
+      import zstandard
+      zdict = None
+      if (dictFn):
+        with open(dictFn, "rb") as f:
+          zdict = zstandard.ZstdCompressionDict(f.read())
+      return zstandard.ZstdDecompressor(dict_data=zdict).decompress(data)
+    except ImportError:
+      return run_filter(["zstd", "-dcq"] + (["-D", dictFn] if dictFn else []), data)
+
+  if (data[:4] == LZ4_MAGIC):
+    try:
+      import lz4.frame
+      return lz4.frame.decompress(data)
+    except ImportError:
+      return run_filter(["lz4", "-dcq"], data)
+
+  return zlib.decompress(data)
+
+def load_record(data):
+  """
+  Convert a run or link record, either JSON or binary and possibly
+  compressed, to python.
+  @param data: the record as bytes (or a JSON str).
+  """
+  if (isinstance(data, bytes) and is_compressed(data)):
+    data = decompress(data)
+  if (isinstance(data, bytes) and is_binary_record(data)):
+    return loads_binary(data)
+  if (isinstance(data, bytes) and not isinstance(data, str)):
+    data = data.decode("utf-8", "surrogateescape")
+  return json.loads(data)
+
+class BinaryReader(object):
+  """
+  Walk through a binary XALT record (kept as a bytearray so that the
+  bytes are ints under python2 and python3).
+  """
+  def __init__(self, data):
+    self.__data  = bytearray(data)
+    self.__pos   = len(MAGIC)
+    self.__end   = len(self.__data)
+    self.__table = []
+
+  def at_end(self):
+    return self.__pos == self.__end
+
+  def byte(self):
+    if (self.__pos >= self.__end):
+      raise ValueError("truncated binary XALT record")
+    c           = self.__data[self.__pos]
+    self.__pos += 1
+    return c
+
+  def varint(self):
+    v     = 0
+    shift = 0
+    while True:
+      c  = self.byte()
+      v |= (c & 0x7f) << shift
+      if (c < 0x80):
+        return v
+      shift += 7
+
+  def read_table(self):
+    for i in range(self.varint()):
+      sz = self.varint()
+      if (self.__pos + sz > self.__end):
+        raise ValueError("truncated binary XALT record")
+      s           = bytes(self.__data[self.__pos:self.__pos+sz])
+      self.__pos += sz
+      self.__table.append(s.decode("utf-8", SURROGATES))
+
+  def string(self):
+    return self.__table[self.varint()]
+
+  def value(self):
+    tag = self.byte()
+    if (tag == 0):
+      return None
+    if (tag == 1):
+      return False
+    if (tag == 2):
+      return True
+    if (tag == 4):
+      return number(self.string())
+    if (tag == 5):
+      return self.string()
+    if (tag == 6):
+      return [ self.value() for i in range(self.varint()) ]
+    if (tag == 7):
+      t = {}
+      for i in range(self.varint()):
+        k    = self.string()
+        t[k] = self.value()
+      return t
+    raise ValueError("unknown tag %d in binary XALT record" % tag)
+
+def number(s):
+  if ("." in s or "e" in s or "E" in s):
+    return float(s)
+  return int(s)
+
+def loads_binary(data):
+  """
+  Convert a binary XALT record to the same python table that json.loads()
+  returns for its JSON form.
+  @param data: the record as bytes.
+  """
+  if (not is_binary_record(data)):
+    raise ValueError("not a binary XALT record")
+
+  reader = BinaryReader(data)
+  reader.read_table()
+  result = reader.value()
+  if (not reader.at_end()):
+    raise ValueError("trailing bytes in binary XALT record")
+  return result
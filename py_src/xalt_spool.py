@@ -0,0 +1,127 @@
+#-----------------------------------------------------------------------
+# XALT: A tool that tracks users jobs and environments on a cluster.
+# Copyright (C) 2013-2014 University of Texas at Austin
+# Copyright (C) 2013-2014 University of Tennessee
+#
+# This library is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as
+# published by the Free Software Foundation; either version 2.1 of
+# the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Lesser  General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free
+# Software Foundation, Inc., 59 Temple Place, Suite 330,
+# Boston, MA 02111-1307 USA
+#-----------------------------------------------------------------------
+from __future__  import print_function
+import fcntl, glob, os, struct, time, zlib
+
+# Reads the segment files written by the spool transmission.  The
+# format is described in src/xalt_spool.h.
+
+REC_MAGIC  = b"XSR1"
+END_MAGIC  = b"XSEGEND1"
+HDR_SZ     = 16
+IDX_SZ     = 16
+TRAILER_SZ = 24
+
+def kind_str(kind):
+  return kind.rstrip(b"\0").decode("ascii", "replace")
+
+def scan_records(data, size):
+  """
+  Walk the records of an unsealed segment, skipping damaged ones.
+  Returns a list of (offset, length, kind).
+  """
+  idxA = []
+  pos  = 0
+  while (pos + HDR_SZ <= size):
+    magic, sz, crc, kind = struct.unpack_from("<4sII4s", data, pos)
+    if (magic == REC_MAGIC and sz <= size - pos - HDR_SZ and
+        zlib.crc32(data[pos+HDR_SZ:pos+HDR_SZ+sz]) & 0xffffffff == crc):
+      idxA.append((pos, sz, kind))
+      pos += HDR_SZ + sz
+      continue
+    pos = data.find(REC_MAGIC, pos + 1, size)
+    if (pos < 0):
+      break
+  return idxA
+
+def read_index(data):
+  """
+  Return the index of a sealed segment as a list of (offset, length,
+  kind), or None when data does not end with a valid index.
+  """
+  if (len(data) < TRAILER_SZ or data[-8:] != END_MAGIC):
+    return None
+  idxOff, n, crc = struct.unpack_from("<QII", data, len(data) - TRAILER_SZ)
+  idxEnd = idxOff + n*IDX_SZ
+  if (idxEnd != len(data) - TRAILER_SZ or
+      zlib.crc32(data[idxOff:idxEnd]) & 0xffffffff != crc):
+    return None
+  return [ struct.unpack_from("<QI4s", data, idxOff + i*IDX_SZ) for i in range(n) ]
+
+def read_segment(fn):
+  """
+  Generator over the records of the segment fn, as (kind, payload).
+  The payload is the record as load_record() takes it.  Records whose
+  checksum does not match are skipped.
+  """
+  with open(fn, "rb") as f:
+    data = f.read()
+
+  idxA = read_index(data)
+  if (idxA is None):
+    idxA = scan_records(data, len(data))
+
+  for pos, sz, kind in idxA:
+    magic, hsz, crc = struct.unpack_from("<4sII", data, pos)
+    payload         = data[pos+HDR_SZ:pos+HDR_SZ+sz]
+    if (magic != REC_MAGIC or hsz != sz or zlib.crc32(payload) & 0xffffffff != crc):
+      continue
+    yield kind_str(kind), payload
+
+def seal_segment(fn):
+  """
+  Seal the open segment fn the way the writers do: append the index and
+  rename it to *.xseg.  Returns the new name, or None if another process
+  sealed it first.
+  """
+  with open(fn, "a+b") as f:
+    fcntl.flock(f, fcntl.LOCK_EX)
+    try:
+      if (os.fstat(f.fileno()).st_ino != os.stat(fn).st_ino):
+        return None
+    except FileNotFoundError:
+      return None
+    f.seek(0)
+    data = f.read()
+    idxA = scan_records(data, len(data))
+    idx  = b"".join(struct.pack("<QI4s", pos, sz, kind) for pos, sz, kind in idxA)
+    f.write(idx + struct.pack("<QII", len(data), len(idxA), zlib.crc32(idx) & 0xffffffff) + END_MAGIC)
+    f.flush()
+    t        = time.time()
+    sealedFn = "%s.%d_%06d_%d.xseg" % (fn[:-5], int(t), int((t % 1)*1000000), os.getpid())
+    os.rename(fn, sealedFn)
+    return sealedFn
+
+def spool_segments(spoolDir, syshost, staleAge=7200):
+  """
+  Return the sealed segments of syshost in spoolDir.  Segments still
+  open staleAge seconds after they were last written to (the writers
+  seal a node's old segments only when it runs XALT again) are sealed
+  first.
+  """
+  now = time.time()
+  for fn in glob.glob(os.path.join(spoolDir, syshost + ".*.open")):
+    try:
+      if (now - os.path.getmtime(fn) > staleAge):
+        seal_segment(fn)
+    except OSError:
+      pass
+  return sorted(glob.glob(os.path.join(spoolDir, syshost + ".*.xseg")))
@@ -46,6 +46,7 @@ from xalt_util     import *
 from xalt_global   import *
 from progressBar   import ProgressBar
 from Rmap_XALT     import Rmap
+from xalt_record_format import load_record, decompress
 
 import inspect
 
@@ -257,7 +258,7 @@ class ParseSyslog(object):
       
       rv   = r.value()
       b64v = base64.b64decode(rv)
-      vv   = zlib.decompress(b64v)
+      vv   = decompress(b64v)
 
       t['value'] = vv
       try:
@@ -428,7 +429,7 @@ def main():
         value = False
 
         try:
-          value = json.loads(t['value'])
+          value = load_record(t['value'])
           filter.register(value)
         except Exception as e:
           #print("fn:",fn,"line:",lineNo,"value:",t['value'],file=sys.stderr)
@@ -469,7 +470,7 @@ def main():
       # If the json conversion fails,
       # then ignore record and keep going
       try:
-        value = json.loads(t['value'])
+        value = load_record(t['value'])
       except Exception as e:
         continue
 
@@ -491,7 +492,7 @@ def main():
           XALT_Stack.push("pkg_to_db()")
           xalt.pkg_to_db(t['syshost'], value)
           XALT_Stack.pop()
-          pkgCnt += 1
+          pkgCnt += len(value.get('pkgA', [value]))
         else:
           print("Error in xalt_syslog_to_db", file=sys.stderr)
         XALT_Stack.pop()
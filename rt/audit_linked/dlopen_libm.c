@@ -0,0 +1,15 @@
+#include <dlfcn.h>
+#include <stdio.h>
+
+/* Load and unload a library so that the run record has a dlopen entry. */
+int main(int argc, char* argv[])
+{
+  void* h = dlopen("libm.so.6", RTLD_NOW);
+  if (h == NULL)
+    {
+      fprintf(stderr, "dlopen failed: %s\n", dlerror());
+      return 1;
+    }
+  dlclose(h);
+  return 0;
+}
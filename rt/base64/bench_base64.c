@@ -0,0 +1,264 @@
+/*
+ * Checks the SIMD base64 code in src/base64.c against the original
+ * scalar implementation (copied below) and times both.
+ *
+ *    make test
+ *
+ * The source is included so that the SIMD kernels can be chosen by
+ * setting encodeP and decodeP.
+ */
+#include "base64.c"
+#include <string.h>
+#include <time.h>
+
+/* The implementation before SIMD (unchanged except for the names). */
+static char* old_base64_encode( const void* binaryData, int len, int *flen )
+{
+  const unsigned char* bin = (const unsigned char*) binaryData ;
+  char* res ;
+  
+  int rc = 0 ; // result counter
+  int byteNo ; // I need this after the loop
+  
+  int modulusLen = len % 3 ;
+  int pad = ((modulusLen&1)<<1) + ((modulusLen&2)>>1) ; // 2 gives 1 and 1 gives 2, but 0 gives 0.
+  
+  *flen = 4*(len + pad)/3 ;
+  res = (char*) malloc( *flen + 1 ) ; // and one for the null
+  if( !res )
+  {
+    puts( "ERROR: base64 could not allocate enough memory." ) ;
+    puts( "I must stop because I could not get enough" ) ;
+    return 0;
+  }
+  
+  for( byteNo = 0 ; byteNo <= len-3 ; byteNo+=3 )
+  {
+    unsigned char BYTE0=bin[byteNo];
+    unsigned char BYTE1=bin[byteNo+1];
+    unsigned char BYTE2=bin[byteNo+2];
+    res[rc++]  = b64[ BYTE0 >> 2 ] ;
+    res[rc++]  = b64[ ((0x3&BYTE0)<<4) + (BYTE1 >> 4) ] ;
+    res[rc++]  = b64[ ((0x0f&BYTE1)<<2) + (BYTE2>>6) ] ;
+    res[rc++]  = b64[ 0x3f&BYTE2 ] ;
+  }
+  
+  if( pad==2 )
+  {
+    res[rc++] = b64[ bin[byteNo] >> 2 ] ;
+    res[rc++] = b64[ (0x3&bin[byteNo])<<4 ] ;
+    res[rc++] = '=';
+    res[rc++] = '=';
+  }
+  else if( pad==1 )
+  {
+    res[rc++]  = b64[ bin[byteNo] >> 2 ] ;
+    res[rc++]  = b64[ ((0x3&bin[byteNo])<<4)   +   (bin[byteNo+1] >> 4) ] ;
+    res[rc++]  = b64[ (0x0f&bin[byteNo+1])<<2 ] ;
+    res[rc++] = '=';
+  }
+  
+  res[rc]=0; // NULL TERMINATOR! ;)
+  return res ;
+}
+
+static unsigned char* old_base64_decode( const char* ascii, int len, int *flen )
+{
+  const unsigned char *safeAsciiPtr = (const unsigned char*)ascii ;
+  unsigned char *bin ;
+  int cb=0;
+  int charNo;
+  int pad = 0 ;
+
+  if( len < 2 ) { // 2 accesses below would be OOB.
+    // catch empty string, return NULL as result.
+    puts( "ERROR: You passed an invalid base64 string (too short). You get NULL back." ) ;
+    *flen=0;
+    return 0 ;
+  }
+  if( safeAsciiPtr[ len-1 ]=='=' )  ++pad ;
+  if( safeAsciiPtr[ len-2 ]=='=' )  ++pad ;
+  
+  *flen = 3*len/4 - pad + 1;
+  bin = (unsigned char*)malloc( *flen ) ;
+  if( !bin )
+  {
+    puts( "ERROR: unbase64 could not allocate enough memory." ) ;
+    puts( "I must stop because I could not get enough" ) ;
+    return 0;
+  }
+  
+  for( charNo=0; charNo <= len - 4 - pad ; charNo+=4 )
+  {
+    int A=unb64[safeAsciiPtr[charNo]];
+    int B=unb64[safeAsciiPtr[charNo+1]];
+    int C=unb64[safeAsciiPtr[charNo+2]];
+    int D=unb64[safeAsciiPtr[charNo+3]];
+    
+    bin[cb++] = (A<<2) | (B>>4) ;
+    bin[cb++] = (B<<4) | (C>>2) ;
+    bin[cb++] = (C<<6) | (D) ;
+  }
+  
+  if( pad==1 )
+  {
+    int A=unb64[safeAsciiPtr[charNo]];
+    int B=unb64[safeAsciiPtr[charNo+1]];
+    int C=unb64[safeAsciiPtr[charNo+2]];
+    
+    bin[cb++] = (A<<2) | (B>>4) ;
+    bin[cb++] = (B<<4) | (C>>2) ;
+  }
+  else if( pad==2 )
+  {
+    int A=unb64[safeAsciiPtr[charNo]];
+    int B=unb64[safeAsciiPtr[charNo+1]];
+    
+    bin[cb++] = (A<<2) | (B>>4) ;
+  }
+  bin[cb] = '\0';
+
+  return bin ;
+}
+
+static long nfail = 0;
+
+#define MAXLEN 1000
+static unsigned char binA[MAXLEN];
+static char          outA[BASE64_ENCODED_LEN(MAXLEN) + 1];
+
+static void check_encode(const char* name, int len)
+{
+  int   flen, n;
+  char* ref = old_base64_encode(binA, len, &flen);
+  n = base64_encode_to(outA, binA, len);
+  if (n != flen || memcmp(ref, outA, flen + 1) != 0)
+    {
+      if (nfail++ < 5)
+        fprintf(stderr, "%s: encode mismatch for %d bytes\n", name, len);
+    }
+  free(ref);
+}
+
+static void check_decode(const char* name, const char* ascii, int len)
+{
+  int            flen, n;
+  unsigned char* ref = old_base64_decode(ascii, len, &flen);
+  unsigned char* got = (unsigned char *) malloc(base64_decoded_len(ascii, len));
+  n = base64_decode_to(got, ascii, len);
+  if (base64_decoded_len(ascii, len) != flen || memcmp(ref, got, n + 1) != 0)
+    {
+      if (nfail++ < 5)
+        fprintf(stderr, "%s: decode mismatch for %d chars\n", name, len);
+    }
+  free(ref);
+  free(got);
+}
+
+static void run_checks(const char* name)
+{
+  int k, i, len;
+  srand(54321);
+  for (k = 0; k < 20000; ++k)
+    {
+      len = rand() % MAXLEN;
+      for (i = 0; i < len; ++i)
+        binA[i] = (unsigned char) rand();
+      check_encode(name, len);
+
+      int n = base64_encode_to(outA, binA, len);
+      if (n >= 2)
+        check_decode(name, outA, n);
+
+      /* Characters outside the alphabet are decoded as 0. */
+      if (n > 4)
+        {
+          static const char badA[] = { ' ', '\n', '-', '_', '=', '.', '\x80', '\xff' };
+          outA[rand() % (n - 4)] = badA[rand() % sizeof(badA)];
+          check_decode(name, outA, n);
+        }
+    }
+  printf("%-6s checks done\n", name);
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}
+
+static void bench(int len)
+{
+  int     i, flen, dlen, iter = 20000000/(len + 64);
+  double  t;
+  char*   big = (char *) malloc(BASE64_ENCODED_LEN(len) + 1);
+  unsigned char* bin = (unsigned char *) malloc(len + 1);
+  for (i = 0; i < len; ++i)
+    bin[i] = (unsigned char) rand();
+
+  t = now();
+  for (i = 0; i < iter; ++i)
+    free(old_base64_encode(bin, len, &flen));
+  double t_old = (now() - t)/iter;
+
+  t = now();
+  for (i = 0; i < iter; ++i)
+    free(base64_encode(bin, len, &flen));
+  double t_new = (now() - t)/iter;
+
+  t = now();
+  for (i = 0; i < iter; ++i)
+    base64_encode_to(big, bin, len);
+  double t_to = (now() - t)/iter;
+
+  t = now();
+  for (i = 0; i < iter; ++i)
+    free(old_base64_decode(big, flen, &dlen));
+  double d_old = (now() - t)/iter;
+
+  t = now();
+  for (i = 0; i < iter; ++i)
+    base64_decode_to(bin, big, flen);
+  double d_to = (now() - t)/iter;
+
+  printf("%7d bytes: encode old %9.1f ns  new %9.1f ns  into buffer %9.1f ns | decode old %9.1f ns  into buffer %9.1f ns\n",
+         len, 1e9*t_old, 1e9*t_new, 1e9*t_to, 1e9*d_old, 1e9*d_to);
+  free(big);
+  free(bin);
+}
+
+int main()
+{
+  encodeP = encode_none;
+  decodeP = decode_none;
+  run_checks("scalar");
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("ssse3"))
+    {
+      encodeP = encode_ssse3;
+      decodeP = decode_ssse3;
+      run_checks("ssse3");
+    }
+  if (__builtin_cpu_supports("avx2"))
+    {
+      encodeP = encode_avx2;
+      decodeP = decode_avx2;
+      run_checks("avx2");
+    }
+#endif
+  if (nfail)
+    {
+      printf("FAILED: %ld mismatches\n", nfail);
+      return 1;
+    }
+  printf("PASS\n");
+
+  pick_simd();
+  bench(48);
+  bench(300);
+  bench(4096);
+  bench(65536);
+  return 0;
+}
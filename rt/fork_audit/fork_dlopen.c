@@ -0,0 +1,29 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Each child loads a library, which gives it an audit log of its own,
+ * and then exits through the normal exit path. */
+int main(int argc, char* argv[])
+{
+  int nchild = (argc > 1) ? atoi(argv[1]) : 3;
+  int i;
+
+  for (i = 0; i < nchild; i++)
+    {
+      pid_t child = fork();
+      if (child == 0)
+        {
+          void* h = dlopen("libm.so.6", RTLD_NOW);
+          if (h)
+            dlclose(h);
+          exit(0);
+        }
+      if (child > 0)
+        waitpid(child, NULL, 0);
+    }
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Differential test of xalt_quotestring_to(): the output with each
+ * scanner (scalar, SSE2, AVX2) must be byte for byte the same as the
+ * one byte at a time reference below.  The source is included so that
+ * the scanner can be chosen by setting plain_lenP.
+ *
+ *    make test
+ */
+#include "xalt_quotestring.c"
+
+static const char *refA[] = { "\\u0000","\\u0001","\\u0002","\\u0003","\\u0004","\\u0005","\\u0006","\\u0007",
+                              "\\b"    ,"\\t"    ,"\\n"    ,"\\u000b","\\f"    ,"\\r"    ,"\\u000e","\\u000f",
+                              "\\u0010","\\u0011",    "\\r","\\u0013","\\u0014","\\u0015","\\u0016","\\u0017",
+                              "\\u0018","\\u0019","\\u001a","\\u001b","\\u001c","\\u001d","\\u001e","\\u001f",
+                              " "      ,      "!",   "\\\""};
+
+static char* ref_quotestring_to(char* s, const char* input, size_t len)
+{
+  const unsigned char *p   = (const unsigned char *) input;
+  const unsigned char *end = p + len;
+  unsigned char        a,b,c,d;
+
+  for (; p < end; ++p)
+    {
+      a = *p;
+      if (a < 0x023)
+        {
+          strcpy(s, refA[a]);
+          s += strlen(refA[a]);
+        }
+      else if (a == '\\')
+        {
+          memcpy(s,"\\\\",2);
+          s += 2;
+        }
+      else if (a < 0x07f)
+        *s++ = a;
+      else
+        {
+          int value;
+          b = (p + 1 < end) ? *++p : 0;
+          if (0xc0 <= a &&  a <= 0xdf &&  b >= 0x80)
+            value = (a - 0xc0) * 0x40 + b - 0x80;
+          else if ( 0xe0 <= a &&  a <= 0xef &&  b >= 0x80 && p + 1 < end && (c = *++p) >= 0x80)
+            value = ((a - 0xe0) * 0x40 + b - 0x80) * 0x40 + c - 0x80;
+          else if (  0xf0 <= a &&  a <= 0xf7 &&  b >= 0x80 && p + 2 < end && (c = *++p) >= 0x80 && (d = *++p) >= 0x80 )
+            value = (((a - 0xf0) * 0x40 + b - 0x80) * 0x40 + c - 0x80) * 0x40 + d - 0x80;
+          else
+            value = 0;
+          if (value <= 0xffff)
+            s += sprintf(s,"\\u%.4x",value);
+          else if (value <= 0x10ffff)
+            {
+              value -= 0x10000;
+              s += sprintf(s,"\\u%.4x\\u%.4x",0xD800 + (value/0x400), 0xDC00 + (value % 0x400));
+            }
+        }
+    }
+  *s = '\0';
+  return s;
+}
+
+#define MAXLEN 300
+static char inA[MAXLEN + 64];
+static char outA[XALT_QUOTESTRING_MAX(MAXLEN)];
+static char refOutA[XALT_QUOTESTRING_MAX(MAXLEN)];
+static long nfail = 0;
+
+static void check(const char* name, const char* in, size_t len)
+{
+  char* e1 = ref_quotestring_to(refOutA, in, len);
+  char* e2 = xalt_quotestring_to(outA, in, len);
+  if (e1 - refOutA != e2 - outA || memcmp(refOutA, outA, e1 - refOutA + 1) != 0)
+    {
+      if (nfail++ < 5)
+        fprintf(stderr, "%s: mismatch for a string of %zu bytes\n  ref: %s\n  got: %s\n",
+                name, len, refOutA, outA);
+    }
+}
+
+/* Mostly plain ASCII with the odd byte that needs quoting. */
+static unsigned char random_byte()
+{
+  static const unsigned char specialA[] = { 0x00, 0x01, '\t', '\n', 0x12, 0x1f, ' ', '!', '"', '\\',
+                                            0x7f, 0x80, 0xc3, 0xa9, 0xe2, 0x82, 0xac, 0xf0, 0x9f, 0xff };
+  int r = rand();
+  if (r % 8 != 0)
+    return (unsigned char) (0x23 + (r >> 3) % (0x7f - 0x23));
+  return specialA[(r >> 3) % sizeof(specialA)];
+}
+
+static void run(const char* name, size_t (*fn)(const unsigned char*, size_t))
+{
+  size_t len, off, i;
+  int    k, b;
+  plain_lenP = fn;
+
+  /* Every byte value at every position of a clean string. */
+  for (len = 1; len <= 70; ++len)
+    for (i = 0; i < len; ++i)
+      for (b = 0; b < 256; ++b)
+        {
+          memset(inA, 'a', len);
+          inA[i] = (char) b;
+          check(name, inA, len);
+        }
+
+  /* Random strings at every alignment. */
+  srand(12345);
+  for (k = 0; k < 200000; ++k)
+    {
+      off = rand() % 32;
+      len = rand() % (MAXLEN + 1);
+      for (i = 0; i < len; ++i)
+        inA[off + i] = (char) random_byte();
+      check(name, &inA[off], len);
+    }
+  printf("%-6s done\n", name);
+}
+
+int main()
+{
+  run("scalar", plain_len_scalar);
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    run("sse2", plain_len_sse2);
+  if (__builtin_cpu_supports("avx2"))
+    run("avx2", plain_len_avx2);
+#endif
+  if (nfail)
+    {
+      printf("FAILED: %ld mismatches\n", nfail);
+      return 1;
+    }
+  printf("PASS\n");
+  return 0;
+}
@@ -24,14 +24,21 @@ public:
   void add(const char* name, Vstring&                  v);
   void add(const char* name, Set&                      s);
   void add(const char* name, std::vector<Libpair>&     lddA);
+  void add(const char* name, std::vector<DlopenRec>&   dlopenA);
   void add(const char* name, std::vector<ProcessTree>& ptA);
   void add(const char* name, int n,     const char   **A);
   void add_json_string(const char* name, std::string&  value);
   std::string& result();
+  int          write(int fd);
 
 private:
+  void reserve(size_t n);
+  void quoted(const char* s, size_t len);
+  void key(const char* name, const char* open);
+  void close(const char* closer);
+
   std::string m_s;
-  std::string m_final;
+  char        m_final;
 };
 
 
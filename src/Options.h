@@ -11,6 +11,7 @@ public:
   ~Options() {}
   long          ntasks()      { return m_ntasks;      }
   long          ngpus()       { return m_ngpus;       }
+  long          nforks()      { return m_nforks;      }
   long          interfaceV()  { return m_interfaceV;  }
   pid_t         pid()         { return m_pid;         }
   pid_t         ppid()        { return m_ppid;        }
@@ -27,13 +28,17 @@ public:
   std::string&  path()        { return m_path;        }
   std::string&  ldLibPath()   { return m_ldLibPath;   }
   std::string&  watermark()   { return m_watermark;   }
+  std::string&  libs()        { return m_libs;        }
 
 private:
+  void        readPayload(int fd);
+
   double      m_start;
   double      m_end;
   double      m_probability;
   long        m_ntasks;
   long        m_ngpus;
+  long        m_nforks;
   long        m_interfaceV;
   pid_t       m_pid;
   pid_t       m_ppid;
@@ -47,6 +52,7 @@ private:
   std::string m_ldLibPath;
   std::string m_kind;
   std::string m_watermark;
+  std::string m_libs;
 };
 
 
@@ -3,6 +3,9 @@
 
 #include "xalt_obfuscate.h"
 
+/* Length of the base64 encoding of n bytes (without the NULL). */
+#define BASE64_ENCODED_LEN(n) (4*(((n) + 2)/3))
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -10,6 +13,9 @@ extern "C"
 
 char*          base64_encode(const void* binaryData, int len, int *flen);
 unsigned char* base64_decode(const char* ascii,      int len, int *flen);
+int            base64_encode_to(char* res,           const void* binaryData, int len);
+int            base64_decoded_len(const char* ascii, int len);
+int            base64_decode_to(unsigned char* bin,  const char* ascii,      int len);
 
 #ifdef __cplusplus
 }
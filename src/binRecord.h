@@ -0,0 +1,32 @@
+#ifndef BINRECORD_H
+#define BINRECORD_H
+
+#include <string>
+
+// A compact binary form of the JSON records (run and link).  It is
+// versioned by its 8 byte magic, which is followed by a string table
+// and a tree of tagged values that refer to the table:
+//
+//    "XALTBIN1"
+//    varint nstr, then nstr times: varint len, len bytes (unquoted UTF-8)
+//    value
+//
+//    value := 0x00 null | 0x01 false | 0x02 true
+//           | 0x04 varint idx            (number, its JSON text)
+//           | 0x05 varint idx            (string)
+//           | 0x06 varint n, n values    (array)
+//           | 0x07 varint n, n times: varint idx (key), value  (object)
+//
+// Varints are unsigned LEB128.  Keys and values that repeat (the
+// library paths, the sha1sums, "file", ...) are stored once.  Numbers
+// keep their JSON text so the conversion back is exact.
+
+#define BINREC_MAGIC      "XALTBIN1"
+#define BINREC_MAGIC_LEN  8
+
+bool isBinRecord(const char* rec, size_t len);
+bool useBinRecord();
+bool json2binRecord(const char* js, size_t len, std::string& out);
+bool binRecord2json(const char* rec, size_t len, std::string& out);
+
+#endif //BINRECORD_H
@@ -7,15 +7,16 @@
 struct Arg
 {
   Arg(const std::string& fnIn)
-    : fn(fnIn), sha1("") {}
+    : fn(fnIn), sha1(""), kind("") {}
   std::string fn;
   std::string sha1;
+  std::string kind;   // "buildid" or "sha1" when XALT_COMPUTE_SHA1=buildid
 };
 
 typedef std::vector<Arg> ArgV;
 
 extern ArgV   argV;
 
-void compute_sha1_master(long n);
+void compute_sha1_master(long n, const char* mode = NULL);
 
 #endif //COMPUTE_SHA1_H
@@ -10,8 +10,14 @@ void buildUserT(Options& options, Table& envT, Table& userT, DTable& userDT);
 void compute_sha1(std::string& fn, std::string& sha1);
 bool extractXALTRecordString(std::string& exec, std::string& watermark);
 void buildXALTRecordT(std::string& watermark, Table& recordT);
-void parseProcMaps(pid_t pid, std::vector<Libpair>& libA, double& t_maps, double& t_sha1);
+void listProcMaps(pid_t pid, Set& soSet);
+void listLibList(const std::string& libs, Set& soSet);
+void readAuditLog(pid_t pid, std::vector<DlopenRec>& dlopenA, Set& soSet);
+void sha1ProcMaps(std::vector<Libpair>& libA, double& t_sha1);
 void pkgRecordTransmit(Options& options, const char* transmission);
+void runRecordTransmit(Options& options, char* env[], std::vector<ProcessTree>& ptA,
+                       std::vector<Libpair>& libA, std::vector<DlopenRec>& dlopenA,
+                       DTable& measureT, double t0);
 void run_direct2db(const char* confFn, std::string& usr_cmdline, std::string& hash_id, 
                    Table& rmapT, Table& envT, Table& userT,
                    Table& recordT, std::vector<Libpair>& lddA);
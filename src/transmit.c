@@ -1,4 +1,5 @@
 #define  _GNU_SOURCE
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -8,6 +9,11 @@
 #include <zlib.h>
 #include "transmit.h"
 #include "zstring.h"
+#include "xalt_compress.h"
+#include "xalt_syslog.h"
+#include "xalt_spool.h"
+#include "xalt_socket.h"
+#include "xalt_retry.h"
 #include "base64.h"
 #include "xalt_config.h"
 #include "xalt_c_utils.h"
@@ -15,23 +21,86 @@
 
 const int syslog_msg_sz = SYSLOG_MSG_SZ;
 
+/* Log the messages through the local syslog socket.  logger(1) is only
+ * run (once per message) when the socket cannot be used.  Returns -1
+ * when some of the messages were dropped so that the record is parked. */
+static int send_syslog(const char* syshost, int nmsg, char** msgA, int* lenA, int xalt_tracing)
+{
+  char  tag[256];
+  char* cmdline = NULL;
+  int   i;
+  snprintf(tag, sizeof(tag), "XALT_LOGGING_%s", syshost);
+
+  int dropped = xalt_syslog(tag, nmsg, msgA, lenA);
+  if (dropped > 0)
+    {
+      DEBUG2(stderr,"  Dropped %d of %d syslog messages: the syslog daemon is busy -> Parked for retry\n",
+             dropped, nmsg);
+      return -1;
+    }
+  if (dropped == 0)
+    return 0;
+
+  for (i = 0; i < nmsg; i++)
+    {
+      asprintf(&cmdline, "PATH=%s logger -t %s \"%s\"\n", XALT_SYSTEM_PATH, tag, msgA[i]);
+      system(cmdline);
+      free(cmdline);
+    }
+  return 0;
+}
+
 void transmit(const char* transmission, const char* jsonStr, const char* kind, const char* key,
               const char* syshost, char* resultDir, const char* resultFn)
 {
-  char * cmdline = NULL;
+  transmit_record(transmission, jsonStr, strlen(jsonStr), 0, kind, key, syshost, resultDir, resultFn);
+}
+
+/* Transmit len bytes of rec.  A record that could not be written (or
+ * spooled or sent) is parked in the retry queue; after a record goes
+ * through, a few parked ones are replayed. */
+void transmit_record(const char* transmission, const char* rec, size_t len, int is_binary,
+                     const char* kind, const char* key, const char* syshost, char* resultDir,
+                     const char* resultFn)
+{
+  int err = transmit_record_once(transmission, rec, len, is_binary, kind, key, syshost,
+                                 resultDir, resultFn);
+
+  // The package records that xalt_record_pkg writes to XALT_TMPDIR are
+  // node local already.
+  if (resultDir && strncmp(resultDir, XALT_TMPDIR, strlen(XALT_TMPDIR)) == 0)
+    return;
+
+  if (err < 0)
+    xalt_retry_park(transmission, rec, len, is_binary, kind, key, syshost, resultDir, resultFn);
+  else if (err == 0)
+    xalt_retry_flush(XALT_RETRY_BATCH, 0, NULL);
+}
+
+/* A JSON record gets a trailing newline in its file; a binary one
+ * (is_binary) is written as is.  With XALT_COMPRESS_FILES=yes the file
+ * holds the compressed record and its name ends with the extension of
+ * the codec. */
+int transmit_record_once(const char* transmission, const char* rec, size_t len, int is_binary,
+                         const char* kind, const char* key, const char* syshost, char* resultDir,
+                         const char* resultFn)
+{
   char * p_dbg        = getenv("XALT_TRACING");
   int    xalt_tracing = (p_dbg && (strcmp(p_dbg,"yes")  == 0 ||
 				   strcmp(p_dbg,"run")  == 0 ));
+  int    result       = 0;
 
   if (strcasecmp(transmission,"directdb") == 0)
     {
       DEBUG0(stderr,"  Direct to DB transmission is NOT supported!\n");
-      return;
+      return 1;
     }
 
 
   if ((strcasecmp(transmission,"file")      != 0 ) &&
       (strcasecmp(transmission,"syslog")    != 0 ) && 
+      (strcasecmp(transmission,"spool")     != 0 ) && 
+      (strcasecmp(transmission,"socket")    != 0 ) && 
       (strcasecmp(transmission,"none")      != 0 ) && 
       (strcasecmp(transmission,"syslogv1")  != 0 ))
     transmission = "file";
@@ -41,7 +110,7 @@ void transmit(const char* transmission, const char* jsonStr, const char* kind, c
       if (resultFn == NULL)
 	{
 	  DEBUG0(stderr,"  resultFn is NULL, $HOME or $USER might be undefined -> No XALT output\n");
-	  return;
+	  return 1;
 	}
 
       int err = mkpath(resultDir, 0700);
@@ -50,67 +119,147 @@ void transmit(const char* transmission, const char* jsonStr, const char* kind, c
 	  if (xalt_tracing)
 	    {
 	      perror("Error: ");
-	      fprintf(stderr,"  unable to mkpath(%s) -> No XALT output\n", resultDir);
+	      fprintf(stderr,"  unable to mkpath(%s) -> Parked for retry\n", resultDir);
 	    }
-	  return;
+	  return -1;
 	}
 
+      const char* ext = "";
+      char*       zs  = NULL;
+      size_t      zslen;
+      if (xalt_compress_files() && (zs = xalt_compress(rec, len, &zslen, &ext)) != NULL)
+        {
+          rec       = zs;
+          len       = zslen;
+          is_binary = 1;
+        }
+
       char* tmpFn = NULL;
-      asprintf(&tmpFn, "%s.%s.new",resultDir, resultFn);
+      asprintf(&tmpFn, "%s.%s%s.new",resultDir, resultFn, ext);
       char* fn = NULL;
-      asprintf(&fn, "%s%s",resultDir, resultFn);
+      asprintf(&fn, "%s%s%s",resultDir, resultFn, ext);
 
-      FILE* fp = fopen(tmpFn,"w");
-      if (fp == NULL && xalt_tracing)
-	fprintf(stderr,"  Unable to open: %s -> No XALT output\n", fn);
+      int fd = open(tmpFn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+      if (fd < 0)
+        {
+          if (xalt_tracing)
+            fprintf(stderr,"  Unable to open: %s -> Parked for retry\n", fn);
+          result = -1;
+        }
       else
         {
-          fprintf(fp, "%s\n", jsonStr);
-          fclose(fp);
-          rename(tmpFn, fn);
-          DEBUG2(stderr,"  Wrote json %s file : %s\n",kind, fn);
+          int err = is_binary ? write_all(fd, rec, len) : write_line(fd, rec, len);
+          close(fd);
+          if (err == 0)
+            {
+              rename(tmpFn, fn);
+              DEBUG3(stderr,"  Wrote %s %s file : %s\n", is_binary ? "binary" : "json", kind, fn);
+            }
+          else
+            {
+              unlink(tmpFn);
+              result = -1;
+            }
         }
       free(tmpFn);
       free(fn);
+      free(zs);
+    }
+  else if (strcasecmp(transmission, "spool") == 0)
+    {
+      const char* ext = "";
+      char*       zs  = NULL;
+      size_t      zslen;
+      if (xalt_compress_files() && (zs = xalt_compress(rec, len, &zslen, &ext)) != NULL)
+        {
+          rec = zs;
+          len = zslen;
+        }
+      if (xalt_spool_append(kind, syshost, rec, len) == 0)
+        {
+          DEBUG2(stderr,"  Appended %s record to the spool segment of %s\n", kind, syshost);
+        }
+      else
+        {
+          DEBUG0(stderr,"  Unable to append to the spool segment -> Parked for retry\n");
+          result = -1;
+        }
+      free(zs);
+    }
+  else if (strcasecmp(transmission, "socket") == 0)
+    {
+      int err = xalt_socket_send(kind, rec, len);
+      if (err == 0)
+        {
+          DEBUG1(stderr,"  Sent %s record to the local socket\n", kind);
+        }
+      else if (err > 0)
+        {
+          DEBUG1(stderr,"  The %s record is too big for a datagram -> dropped\n", kind);
+          result = 1;
+        }
+      else
+        {
+          DEBUG1(stderr,"  Unable to send %s record to the local socket -> Parked for retry\n", kind);
+          result = -1;
+        }
     }
   else if (strcasecmp(transmission, "syslogv1") == 0)
     {
       int   zslen;
-      int   b64len;
-      char* zs      = compress_string(jsonStr,&zslen);
-      char* b64     = base64_encode(zs, zslen, &b64len);
-      
-      asprintf(&cmdline, "PATH=%s logger -t XALT_LOGGING_%s \"%s:%s\"\n",XALT_SYSTEM_PATH, syshost, kind, b64);
-      system(cmdline);
+      char* zs      = compress_buf(rec, len, &zslen);
+      int   kindLen = strlen(kind);
+      char* msg     = (char *) malloc(kindLen + 1 + BASE64_ENCODED_LEN(zslen) + 1);
+      int   msgLen;
+
+      // The record is encoded straight into the message after "kind:".
+      memcpy(msg, kind, kindLen);
+      msg[kindLen] = ':';
+      msgLen = kindLen + 1 + base64_encode_to(&msg[kindLen + 1], zs, zslen);
+
+      result = send_syslog(syshost, 1, &msg, &msgLen, xalt_tracing);
       free(zs);
-      free(b64);
-      free(cmdline);
-      
+      free(msg);
     }
   else if (strcasecmp(transmission, "syslog") == 0)
     {
-      int   sz;
-      int   zslen;
-      char* zs      = compress_string(jsonStr, &zslen);
-      char* b64     = base64_encode(zs, zslen, &sz);
-      
-      int   blkSz   = (sz < syslog_msg_sz) ? sz : syslog_msg_sz;
-      int   nBlks   = (sz -  1)/blkSz + 1;
-      int   istrt   = 0;
-      int   iend    = blkSz;
+      int         sz;
+      size_t      zslen;
+      const char* ext;
+      char*       zs      = xalt_compress(rec, len, &zslen, &ext);
+      if (zs == NULL)
+        return 1;
+      // Each block encodes its own slice of zs straight into its
+      // message, so a block holds a multiple of 4 characters (3 bytes).
+      sz = BASE64_ENCODED_LEN(zslen);
+      int   blkSz   = (syslog_msg_sz < 4) ? 4 : syslog_msg_sz/4*4;
+      if (sz < blkSz)
+        blkSz = sz;
+      int   rawSz   = blkSz/4*3;
+      int   nBlks   = ((int) zslen - 1)/rawSz + 1;
       int   i;
+      char** msgA   = (char **) malloc(nBlks*sizeof(char *));
+      int*   lenA   = (int *)   malloc(nBlks*sizeof(int));
 
       for (i = 0; i < nBlks; i++)
         {
-          asprintf(&cmdline, "PATH=%s logger -t XALT_LOGGING_%s V:2 kind:%s idx:%d nb:%d syshost:%s key:%s value:%.*s\n",
-                   XALT_SYSTEM_PATH, syshost, kind, i, nBlks, syshost, key, iend-istrt, &b64[istrt]);
-          system(cmdline);
-          free(cmdline);
-          istrt = iend;
-          iend  = istrt + blkSz;
-          if (iend > sz)
-            iend = sz;
+          int   istrt = i*rawSz;
+          int   n     = ((int) zslen - istrt < rawSz) ? (int) zslen - istrt : rawSz;
+          int   hlen  = snprintf(NULL, 0, "V:2 kind:%s idx:%d nb:%d syshost:%s key:%s value:",
+                                 kind, i, nBlks, syshost, key);
+          msgA[i] = (char *) malloc(hlen + BASE64_ENCODED_LEN(n) + 1);
+          sprintf(msgA[i], "V:2 kind:%s idx:%d nb:%d syshost:%s key:%s value:",
+                  kind, i, nBlks, syshost, key);
+          lenA[i] = hlen + base64_encode_to(&msgA[i][hlen], &zs[istrt], n);
         }
-      free(b64);
+      free(zs);
+      result = send_syslog(syshost, nBlks, msgA, lenA, xalt_tracing);
+      for (i = 0; i < nBlks; i++)
+        free(msgA[i]);
+      free(msgA);
+      free(lenA);
     }
+  else
+    result = 1;       /* none */
+  return result;
 }
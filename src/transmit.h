@@ -1,5 +1,6 @@
 #ifndef TRANSMIT_H
 #define TRANSMIT_H
+#include <stddef.h>
 #ifdef __cplusplus
 extern "C"
 {
@@ -7,6 +8,16 @@ extern "C"
 
 void transmit(const char* transmission, const char* jsonStr, const char* kind, const char* key,
               const char* syshost, char* resultDir, const char* resultFn);
+void transmit_record(const char* transmission, const char* rec, size_t len, int is_binary,
+                     const char* kind, const char* key, const char* syshost, char* resultDir,
+                     const char* resultFn);
+
+/* Transmit once, without the retry queue.  Returns 0 when the record
+ * went through, -1 when it failed in a way that is worth retrying and 1
+ * when there was nothing to do. */
+int  transmit_record_once(const char* transmission, const char* rec, size_t len, int is_binary,
+                          const char* kind, const char* key, const char* syshost, char* resultDir,
+                          const char* resultFn);
 
 #ifdef __cplusplus
 }
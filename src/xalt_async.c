@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "xalt_async.h"
+
+/*
+ * Grab one of max_slots lock files in tmpdir.  The slots are per user
+ * so that one user's burst of exiting programs cannot starve another
+ * user and so that the lock files are always owned by the caller.
+ * Returns the locked file descriptor or -1 if every slot is busy.
+ */
+static int grab_slot(const char* tmpdir, int max_slots)
+{
+  int i;
+  int start = (int) (getpid() % max_slots);
+
+  for (i = 0; i < max_slots; ++i)
+    {
+      char* fn   = NULL;
+      int   slot = (start + i) % max_slots;
+      asprintf(&fn, "%s/XALT_async_%u_%d.lock", tmpdir, (unsigned int) getuid(), slot);
+      int fd = open(fn, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+      free(fn);
+      if (fd < 0)
+        return -1;
+      if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+        return fd;
+      close(fd);
+    }
+  return -1;
+}
+
+/*
+ * Close every inherited descriptor except stdin/stdout/stderr and the
+ * slot lock.  xalt_run_submission inherits the user program's open
+ * files; a detached child holding the write end of a pipe would keep
+ * the reader (e.g. "prog | grep foo") waiting until the record is done.
+ */
+static void close_inherited_fds(int keep_fd)
+{
+  int  fdA[256];
+  int  n = 0;
+  int  i;
+  DIR* dirp;
+
+  do
+    {
+      struct dirent* dp;
+      dirp = opendir("/proc/self/fd");
+      if (dirp == NULL)
+        return;
+      n = 0;
+      while ( (dp = readdir(dirp)) != NULL && n < 256)
+        {
+          int fd = atoi(dp->d_name);
+          if (fd > STDERR_FILENO && fd != keep_fd && fd != dirfd(dirp))
+            fdA[n++] = fd;
+        }
+      closedir(dirp);
+      for (i = 0; i < n; ++i)
+        close(fdA[i]);
+    }
+  while (n == 256);
+}
+
+/*
+ * Detach the caller from the user's program.  On success the calling
+ * process exits right away (so myfini() stops waiting) and this routine
+ * returns 1 in a grandchild that has been re-parented, lives in its own
+ * session and holds one of the concurrency slots until it exits.
+ * Returns 0 when no slot is free or the fork fails: the caller must
+ * then finish the work synchronously.
+ */
+int xalt_async_detach(const char* tmpdir, int max_slots, int keep_stderr)
+{
+  int   lock_fd;
+  int   null_fd;
+  pid_t child;
+
+  if (max_slots < 1)
+    return 0;
+
+  lock_fd = grab_slot(tmpdir, max_slots);
+  if (lock_fd < 0)
+    return 0;
+
+  fflush(stdout);
+  fflush(stderr);
+
+  child = fork();
+  if (child < 0)
+    {
+      close(lock_fd);
+      return 0;
+    }
+  if (child > 0)
+    _exit(0);
+
+  /* Grandchild: the flock is shared with our (now gone) parent's
+     descriptor and stays held until this process exits. */
+  setsid();
+  signal(SIGHUP, SIG_IGN);
+
+  close_inherited_fds(lock_fd);
+  null_fd = open("/dev/null", O_RDWR);
+  if (null_fd >= 0)
+    {
+      dup2(null_fd, STDIN_FILENO);
+      dup2(null_fd, STDOUT_FILENO);
+      if (! keep_stderr)
+        dup2(null_fd, STDERR_FILENO);
+      if (null_fd > STDERR_FILENO)
+        close(null_fd);
+    }
+  return 1;
+}
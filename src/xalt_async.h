@@ -0,0 +1,19 @@
+#ifndef XALT_ASYNC_H
+#define XALT_ASYNC_H
+
+/* Default number of detached end-record submissions a user may have
+   running on a node at the same time (see XALT_ASYNC_FINI_MAX). */
+#define XALT_ASYNC_FINI_MAX 8
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int xalt_async_detach(const char* tmpdir, int max_slots, int keep_stderr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XALT_ASYNC_H */
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "xalt_config.h"
+#include "xalt_audit.h"
+
+/*
+ * libxalt_audit.so: an rtld-audit(7) library that records every shared
+ * object the program loads and unloads.  Use it with
+ *
+ *    LD_AUDIT=$XALT_DIR/$LIB/libxalt_audit.so
+ *
+ * next to LD_PRELOAD=.../libxalt_init.so.  The callbacks only update a
+ * table (path, first load time, last unload time, counts); nothing is
+ * hashed or read here.  The table starts out in private memory and is
+ * moved to a file in XALT_TMPDIR (see xalt_audit.h) as soon as
+ * libxalt_init.so is loaded, so programs that XALT does not track (and
+ * XALT's own programs) never create a file.  The dynamic linker holds
+ * its lock around these callbacks so no other locking is needed.
+ */
+
+static xalt_audit_log_t* logG    = NULL;
+static int               sharedG = 0;    /* 1 => logG is the mmap'ed file */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}
+
+static uint32_t hash_str(const char* s, size_t len)
+{
+  uint32_t h = 2166136261u;              /* FNV-1a */
+  size_t   i;
+  for (i = 0; i < len; ++i)
+    h = (h ^ (unsigned char) s[i]) * 16777619u;
+  return h;
+}
+
+/* Move the log into XALT_TMPDIR/XALT_audit_<uid>_<pid>. */
+static void share_log()
+{
+  char fn[PATH_MAX];
+  snprintf(fn, sizeof(fn), XALT_AUDIT_FMT, XALT_TMPDIR, (unsigned int) getuid(), (int) getpid());
+
+  int fd = open(fn, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return;
+  if (ftruncate(fd, sizeof(xalt_audit_log_t)) != 0)
+    {
+      close(fd);
+      unlink(fn);
+      return;
+    }
+  void* p = mmap(NULL, sizeof(xalt_audit_log_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    {
+      unlink(fn);
+      return;
+    }
+
+  /* Only copy the parts in use: the file is sparse. */
+  xalt_audit_log_t* log = (xalt_audit_log_t *) p;
+  memcpy(log, logG, offsetof(xalt_audit_log_t, entryA));
+  memcpy(log->entryA, logG->entryA, logG->nentry*sizeof(xalt_audit_entry_t));
+  memcpy(log->arena,  logG->arena,  logG->arena_used);
+  log->pid = (int32_t) getpid();
+  if (! sharedG)
+    munmap(logG, sizeof(xalt_audit_log_t));
+  logG    = log;
+  sharedG = 1;
+}
+
+/* A child of fork() must not write into its parent's file. */
+static void check_fork()
+{
+  if (logG && sharedG && logG->pid != (int32_t) getpid())
+    share_log();
+}
+
+unsigned int la_version(unsigned int version)
+{
+  if (logG == NULL)
+    {
+      void* p = mmap(NULL, sizeof(xalt_audit_log_t), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p != MAP_FAILED)
+        {
+          logG        = (xalt_audit_log_t *) p;
+          logG->magic = XALT_AUDIT_MAGIC;
+          logG->pid   = (int32_t) getpid();
+        }
+    }
+  return LAV_CURRENT;
+}
+
+unsigned int la_objopen(struct link_map* map, Lmid_t lmid, uintptr_t* cookie)
+{
+  uint32_t i;
+  *cookie = 0;
+  if (logG == NULL || map->l_name == NULL || map->l_name[0] != '/')
+    return 0;
+  check_fork();
+
+  const char* name = map->l_name;
+  size_t      len  = strlen(name);
+  uint32_t    h    = hash_str(name, len);
+  for (i = 0; i < logG->nentry; ++i)
+    {
+      xalt_audit_entry_t* e = &logG->entryA[i];
+      if (e->hash == h && e->name_len == len && memcmp(&logG->arena[e->name_off], name, len) == 0)
+        {
+          e->nopen++;
+          *cookie = i + 1;
+          return 0;
+        }
+    }
+
+  if (logG->nentry >= XALT_AUDIT_NENTRY || logG->arena_used + len + 1 > XALT_AUDIT_ARENA)
+    {
+      logG->overflow++;
+      return 0;
+    }
+  xalt_audit_entry_t* e = &logG->entryA[logG->nentry];
+  memcpy(&logG->arena[logG->arena_used], name, len + 1);
+  e->name_off      = logG->arena_used;
+  e->name_len      = (uint32_t) len;
+  e->hash          = h;
+  e->t_open        = now();
+  e->t_close       = 0.0;
+  e->nopen         = 1;
+  e->nclose        = 0;
+  logG->arena_used += (uint32_t) len + 1;
+  *cookie          = ++logG->nentry;
+
+  if (! sharedG && lmid == LM_ID_BASE && strstr(strrchr(name, '/'), "libxalt_init.so"))
+    share_log();
+  return 0;
+}
+
+unsigned int la_objclose(uintptr_t* cookie)
+{
+  if (logG == NULL || *cookie == 0 || *cookie > logG->nentry)
+    return 0;
+  check_fork();
+
+  xalt_audit_entry_t* e = &logG->entryA[*cookie - 1];
+  e->nclose++;
+  e->t_close = now();
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef XALT_AUDIT_H
+#define XALT_AUDIT_H
+
+#include <stdint.h>
+
+/*
+ * The log that libxalt_audit.so (loaded with LD_AUDIT) keeps of every
+ * shared object a program loads, including the ones that are
+ * dlopen()'d and dlclose()'d between myinit() and myfini().  It lives
+ * in XALT_TMPDIR/XALT_audit_<uid>_<pid> so that xalt_run_submission or
+ * xalt_collectord can read it for the end record; libxalt_init.so
+ * removes it at the end of myfini().  The layout is the same for 32 and
+ * 64 bit programs.
+ */
+
+#define XALT_AUDIT_MAGIC    0x31445541544c4158ULL   /* "XALTAUD1" */
+#define XALT_AUDIT_NENTRY   4096
+#define XALT_AUDIT_ARENA    (1 << 20)               /* bytes for the paths */
+#define XALT_AUDIT_FMT      "%s/XALT_audit_%u_%d"   /* tmpdir, uid, pid */
+
+typedef struct
+{
+  double   t_open;                     /* epoch of the first la_objopen */
+  double   t_close;                    /* epoch of the last la_objclose, 0 if never closed */
+  uint32_t nopen;                      /* number of times it was loaded */
+  uint32_t nclose;                     /* number of times it was unloaded */
+  uint32_t name_off;                   /* path in the arena, NUL terminated */
+  uint32_t name_len;
+  uint32_t hash;
+  uint32_t pad;
+} xalt_audit_entry_t;
+
+typedef struct
+{
+  uint64_t           magic;
+  int32_t            pid;
+  uint32_t           nentry;           /* entries in use */
+  uint32_t           arena_used;
+  uint32_t           overflow;         /* objects dropped because the log was full */
+  char               pad[40];
+  xalt_audit_entry_t entryA[XALT_AUDIT_NENTRY];
+  char               arena[XALT_AUDIT_ARENA];
+} xalt_audit_log_t;
+
+#endif /* XALT_AUDIT_H */
@@ -1,6 +1,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include "xalt_c_utils.h"
 
@@ -30,3 +31,47 @@ int mkpath(char* file_path, mode_t mode)
     }
   return 0;
 }
+
+/* Write all of iov[0..n), retrying after EINTR and short writes. */
+static int write_iov(int fd, struct iovec* iov, int n)
+{
+  int i = 0;
+  while (i < n)
+    {
+      ssize_t k = writev(fd, &iov[i], n - i);
+      if (k < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+      while (i < n && (size_t) k >= iov[i].iov_len)
+        k -= iov[i++].iov_len;
+      if (i < n)
+        {
+          iov[i].iov_base = (char *) iov[i].iov_base + k;
+          iov[i].iov_len -= k;
+        }
+    }
+  return 0;
+}
+
+/* Write len bytes of s followed by a newline, without copying s. */
+int write_line(int fd, const char* s, size_t len)
+{
+  struct iovec iov[2];
+  iov[0].iov_base = (void *) s;
+  iov[0].iov_len  = len;
+  iov[1].iov_base = (void *) "\n";
+  iov[1].iov_len  = 1;
+  return write_iov(fd, iov, 2);
+}
+
+/* Write exactly len bytes of s. */
+int write_all(int fd, const char* s, size_t len)
+{
+  struct iovec iov[1];
+  iov[0].iov_base = (void *) s;
+  iov[0].iov_len  = len;
+  return write_iov(fd, iov, 1);
+}
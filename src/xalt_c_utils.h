@@ -10,6 +10,8 @@ extern "C"
 
 int   isDirectory(const char *path);
 int   mkpath(char *path, mode_t mode);
+int   write_line(int fd, const char* s, size_t len);
+int   write_all(int fd, const char* s, size_t len);
 
 #ifdef __cplusplus
 }
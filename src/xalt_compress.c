@@ -0,0 +1,242 @@
+#define  _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "xalt_compress.h"
+#include "xalt_config.h"
+
+/* The few entry points of libzstd and liblz4 that are used.  Their ABI
+ * has been stable since zstd 1.0 and lz4 1.8. */
+typedef size_t (*zstd_bound_t)(size_t);
+typedef size_t (*zstd_compress_t)(void*, size_t, const void*, size_t, int);
+typedef unsigned (*zstd_iserror_t)(size_t);
+typedef void*  (*zstd_create_cctx_t)(void);
+typedef void*  (*zstd_create_cdict_t)(const void*, size_t, int);
+typedef size_t (*zstd_compress_cdict_t)(void*, void*, size_t, const void*, size_t, const void*);
+
+typedef struct
+{
+  int                blockSizeID;
+  int                blockMode;
+  int                contentChecksumFlag;
+  int                frameType;
+  unsigned long long contentSize;
+  unsigned           dictID;
+  int                blockChecksumFlag;
+} lz4f_frame_info_t;
+
+typedef struct
+{
+  lz4f_frame_info_t  frameInfo;
+  int                compressionLevel;
+  unsigned           autoFlush;
+  unsigned           favorDecSpeed;
+  unsigned           reserved[3];
+} lz4f_prefs_t;
+
+typedef size_t   (*lz4f_bound_t)(size_t, const lz4f_prefs_t*);
+typedef size_t   (*lz4f_compress_t)(void*, size_t, const void*, size_t, const lz4f_prefs_t*);
+typedef unsigned (*lz4f_iserror_t)(size_t);
+
+static void* open_lib(const char* name)
+{
+  char  soname[64];
+  void* h;
+  snprintf(soname, sizeof(soname), "%s.so.1", name);
+  h = dlopen(soname, RTLD_NOW | RTLD_LOCAL);
+  if (h == NULL)
+    {
+      snprintf(soname, sizeof(soname), "%s.so", name);
+      h = dlopen(soname, RTLD_NOW | RTLD_LOCAL);
+    }
+  return h;
+}
+
+static char* zlib_compress(const char* in, size_t len, int level, size_t* lenOut)
+{
+  uLongf outLen = compressBound(len);
+  char*  out    = (char *) malloc(outLen);
+  if (out == NULL || compress2((Bytef *) out, &outLen, (const Bytef *) in, len, level) != Z_OK)
+    {
+      free(out);
+      return NULL;
+    }
+  *lenOut = outLen;
+  return out;
+}
+
+/* Read the dictionary named by XALT_ZSTD_DICT, if any. */
+static void* read_dict(size_t* sz)
+{
+  const char* fn = getenv("XALT_ZSTD_DICT");
+  struct stat st;
+  void*       buf;
+  int         fd;
+  if (fn == NULL)
+    fn = XALT_ZSTD_DICT;
+  if (fn[0] == '\0' || (fd = open(fn, O_RDONLY | O_CLOEXEC)) < 0)
+    return NULL;
+  buf = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 && (buf = malloc(st.st_size)) != NULL)
+    {
+      if (read(fd, buf, st.st_size) == st.st_size)
+        *sz = st.st_size;
+      else
+        {
+          free(buf);
+          buf = NULL;
+        }
+    }
+  close(fd);
+  return buf;
+}
+
+static char* zstd_compress(const char* in, size_t len, int level, size_t* lenOut)
+{
+  static void*                 h = NULL;
+  static zstd_bound_t          bound;
+  static zstd_compress_t       compress;
+  static zstd_iserror_t        iserror;
+  static zstd_compress_cdict_t compress_cdict;
+  static void*                 cctx  = NULL;
+  static void*                 cdict = NULL;
+
+  if (h == NULL)
+    {
+      if ((h = open_lib("libzstd")) == NULL)
+        return NULL;
+      bound    = (zstd_bound_t)    dlsym(h, "ZSTD_compressBound");
+      compress = (zstd_compress_t) dlsym(h, "ZSTD_compress");
+      iserror  = (zstd_iserror_t)  dlsym(h, "ZSTD_isError");
+      if (bound == NULL || compress == NULL || iserror == NULL)
+        {
+          dlclose(h);
+          h = NULL;
+          return NULL;
+        }
+
+      size_t dictSz;
+      void*  dict = read_dict(&dictSz);
+      if (dict)
+        {
+          zstd_create_cctx_t  create_cctx  = (zstd_create_cctx_t)  dlsym(h, "ZSTD_createCCtx");
+          zstd_create_cdict_t create_cdict = (zstd_create_cdict_t) dlsym(h, "ZSTD_createCDict");
+          compress_cdict = (zstd_compress_cdict_t) dlsym(h, "ZSTD_compress_usingCDict");
+          if (create_cctx && create_cdict && compress_cdict)
+            {
+              cctx  = (*create_cctx)();
+              cdict = (*create_cdict)(dict, dictSz, level);
+            }
+          free(dict);
+        }
+    }
+
+  size_t cap = (*bound)(len);
+  char*  out = (char *) malloc(cap);
+  size_t n;
+  if (out == NULL)
+    return NULL;
+  if (cctx && cdict)
+    n = (*compress_cdict)(cctx, out, cap, in, len, cdict);
+  else
+    n = (*compress)(out, cap, in, len, level);
+  if ((*iserror)(n))
+    {
+      free(out);
+      return NULL;
+    }
+  *lenOut = n;
+  return out;
+}
+
+static char* lz4_compress(const char* in, size_t len, int level, size_t* lenOut)
+{
+  static void*           h = NULL;
+  static lz4f_bound_t    bound;
+  static lz4f_compress_t compress;
+  static lz4f_iserror_t  iserror;
+
+  if (h == NULL)
+    {
+      if ((h = open_lib("liblz4")) == NULL)
+        return NULL;
+      bound    = (lz4f_bound_t)    dlsym(h, "LZ4F_compressFrameBound");
+      compress = (lz4f_compress_t) dlsym(h, "LZ4F_compressFrame");
+      iserror  = (lz4f_iserror_t)  dlsym(h, "LZ4F_isError");
+      if (bound == NULL || compress == NULL || iserror == NULL)
+        {
+          dlclose(h);
+          h = NULL;
+          return NULL;
+        }
+    }
+
+  lz4f_prefs_t prefs;
+  memset(&prefs, 0, sizeof(prefs));
+  prefs.frameInfo.contentSize = len;
+  prefs.compressionLevel      = level;
+
+  size_t cap = (*bound)(len, &prefs);
+  char*  out = (char *) malloc(cap);
+  if (out == NULL)
+    return NULL;
+  size_t n = (*compress)(out, cap, in, len, &prefs);
+  if ((*iserror)(n))
+    {
+      free(out);
+      return NULL;
+    }
+  *lenOut = n;
+  return out;
+}
+
+char* xalt_compress(const char* in, size_t len, size_t* lenOut, const char** ext)
+{
+  char        codec[16];
+  const char* spec = getenv("XALT_COMPRESSION");
+  const char* p;
+  char*       out  = NULL;
+  int         level;
+
+  if (spec == NULL)
+    spec = XALT_COMPRESSION;
+  p = strchr(spec, ':');
+  snprintf(codec, sizeof(codec), "%.*s", (int) (p ? (size_t) (p - spec) : strlen(spec)), spec);
+
+  if (strcasecmp(codec, "zstd") == 0)
+    {
+      level = p ? atoi(p+1) : 3;
+      out   = zstd_compress(in, len, level, lenOut);
+      *ext  = ".zst";
+    }
+  else if (strcasecmp(codec, "lz4") == 0)
+    {
+      level = p ? atoi(p+1) : 0;
+      out   = lz4_compress(in, len, level, lenOut);
+      *ext  = ".lz4";
+    }
+
+  if (out == NULL)
+    {
+      level = (p && strcasecmp(codec, "zlib") == 0) ? atoi(p+1) : Z_DEFAULT_COMPRESSION;
+      out   = zlib_compress(in, len, level, lenOut);
+      *ext  = ".zz";
+    }
+  return out;
+}
+
+/* XALT_COMPRESS_FILES=yes compresses the records written by the file
+ * transmission too. */
+int xalt_compress_files()
+{
+  const char* v = getenv("XALT_COMPRESS_FILES");
+  if (v == NULL)
+    v = XALT_COMPRESS_FILES;
+  return strcasecmp(v, "yes") == 0;
+}
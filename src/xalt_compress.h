@@ -0,0 +1,26 @@
+#ifndef XALT_COMPRESS_H
+#define XALT_COMPRESS_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * The codec used for records that are compressed (syslog always, files
+ * when XALT_COMPRESS_FILES=yes) is XALT_COMPRESSION: "zlib", "zstd" or
+ * "lz4", optionally followed by ":level".  zstd and lz4 are dlopen()'ed
+ * so XALT does not need them to build; zlib is used when they cannot be
+ * loaded.  The output is self describing (zlib header, zstd or lz4
+ * frame) so the ingesters can tell the codecs apart.
+ */
+
+char* xalt_compress(const char* in, size_t len, size_t* lenOut, const char** ext);
+int   xalt_compress_files();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_COMPRESS_H
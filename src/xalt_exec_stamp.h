@@ -0,0 +1,23 @@
+#ifndef XALT_EXEC_STAMP_H
+#define XALT_EXEC_STAMP_H
+
+#include <sys/stat.h>
+
+/*
+ * xalt_generate_linkdata stamps an executable that XALT's ld has just
+ * written with the extended attribute XALT_EXEC_STAMP_ATTR:
+ *
+ *     "<Build_UUID> <size> <mtime sec>.<mtime nsec>"
+ *
+ * and puts the same size and mtime in the link record.  A run of the
+ * executable only skips its sha1sum (XALT_WATERMARK_EXEC_ID=yes) when
+ * the stamp matches both the watermark and the file as it is now.  A
+ * copy, a strip or any write changes the mtime or drops the attribute.
+ * On a file system without user extended attributes there is no stamp
+ * and the executable is hashed as before.
+ */
+
+#define XALT_EXEC_STAMP_ATTR "user.xalt.exec_stamp"
+#define XALT_EXEC_STAMP_SZ   128
+
+#endif /* XALT_EXEC_STAMP_H */
@@ -26,6 +26,7 @@
 
 #define  _GNU_SOURCE
 #include <assert.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -33,6 +34,9 @@
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include <limits.h>
 #include "xalt_regex.h"
 #include "xalt_interval.h"
@@ -43,6 +47,9 @@
 #ifdef __MACH__
 #  include <libproc.h>
 #endif
+#ifdef __linux__
+#  include <link.h>
+#endif
 #include "xalt_obfuscate.h"
 #include "base64.h"
 #include "xalt_quotestring.h"
@@ -54,6 +61,10 @@
 #include "build_uuid.h"
 #include "xalt_tmpdir.h"
 #include "xalt_vendor_note.h"
+#include "xalt_spawn.h"
+#include "xalt_payload.h"
+#include "xalt_ring.h"
+#include "xalt_audit.h"
 
 #if USE_DCGM && USE_NVML
 #error "Both DCGM and NVML enabled.  This is not allowed."
@@ -81,6 +92,20 @@
 
 
 #define DATESZ    100
+#define NUMSZ     40
+#define ARGSZ     40
+#define LIBLISTSZ 100000   /* longest library list passed as an argument */
+
+/* A slot of the hash set of the library names already in libListArg:
+ * len == 0 marks an empty slot. */
+typedef struct
+{
+  uint64_t hash;
+  uint32_t off;
+  uint32_t len;
+} libSlot_t;
+#define DECISION_SLOTS  8192   /* entries in the path/hostname decision cache */
+#define DECISION_PROBES 16
 
 typedef enum { BIT_SCALAR = 1, BIT_PKGS = 2, BIT_MPI = 4} xalt_tracking_flags;
 typedef enum { PKGS=1, KEEP=2, SKIP=3} xalt_parser;
@@ -136,6 +161,21 @@ static void            get_abspath(char * path, int sz);
 static volatile double epoch();
 static unsigned int    mix(unsigned int a, unsigned int b, unsigned int c); 
 static double          scalar_program_sample_probability(double runtime);
+static void            build_submission_argv(const char * run_submission, double end_time, const char * wm,
+                                             const char * cmdline, int payload_fd, char numA[][NUMSZ],
+                                             char ** argA);
+static char *          submission_argv_str(char ** argA);
+static int             spawn_run_submission(const char * run_submission, double end_time, double * t_launch);
+static void            encode_argv_strings();
+static void            add_loaded_libs();
+static const char *    lib_list();
+static void            remove_audit_log();
+static void            after_fork_in_child();
+static int             push_to_collector(double end_time, double * t_launch);
+static int             build_run_state(int argc, char ** argv);
+static void            open_decision_cache();
+static xalt_parser     cached_decision(char kind, const char * name);
+static void            cache_decision(char kind, const char * name, xalt_parser result);
 #ifdef USE_NVML
 static int             load_nvml();
 #endif
@@ -149,7 +189,7 @@ void wrapper_for_myfini(int signum);
 static int          countA[2];
 static char         uuid_str[37];
 static char         exec_path[PATH_MAX+1];
-static char *       exec_pathQ;
+static char *       exec_pathQ            = NULL;             /* only built for argv and the collector */
 static char *       usr_cmdline;
 static char *       b64_cmdline;
 static const char * my_syshost;
@@ -173,8 +213,23 @@ static int          xalt_kind             = 0;
 static int          xalt_tracing          = 0;
 static int          xalt_run_tracing      = 0;
 static int          xalt_gpu_tracking     = 0;
+static int          xalt_collector        = 0;
+static int          lazy_scalar           = 0;                /* 1 => build the record in myfini() */
+static int          my_argc               = 0;
+static int          forked_child          = 0;                /* 1 => a fork() of the tracked process */
+static uint32_t *   fork_count            = NULL;             /* shared with the children, see XALT_FORK_SUMMARY */
+static char **      my_argv               = NULL;
+static uint64_t *   decisionA             = NULL;             /* the mmap'ed decision cache */
+static uint64_t     decision_gen          = 0;
 static char *       pathArg	          = NULL;
 static char *       ldLibPathArg          = NULL;
+static char *       libListArg            = NULL;             /* ':' separated list of shared libraries */
+static size_t       libListLen            = 0;
+static size_t       libListCap            = 0;
+static int          libListBad            = 0;                /* 1 => a library name has a ':' */
+static libSlot_t *  libSetA               = NULL;             /* hash set of the names in libListArg */
+static size_t       libSetCap             = 0;                /* a power of 2, or 0 */
+static size_t       libSetCnt             = 0;
 static int          num_gpus              = 0;
 static int          b64_len               = 0;
 static int          b64_wm_len            = 0;
@@ -233,11 +288,8 @@ void myinit(int argc, char **argv)
   int    produce_strt_rec = 0;
   char * p;
   char * p_dbg;
-  char * cmdline         = NULL;
   char * ld_preload_strp = NULL;
-  char   rand_str[20];
   char   dateStr[DATESZ];
-  char   fullDateStr[DATESZ];
   const char * v;
   xalt_parser  results;
   xalt_parser  path_results;
@@ -249,6 +301,11 @@ void myinit(int argc, char **argv)
 
   struct utsname u;
 
+  /* A child made by fork() shares this run: its exit must not produce
+   * another record for the same uuid (see myfini()). */
+  pid = getpid();
+  pthread_atfork(NULL, NULL, after_fork_in_child);
+
   p_dbg = getenv("XALT_TRACING");
   if (p_dbg)
     {
@@ -258,6 +315,9 @@ void myinit(int argc, char **argv)
 	errfd	       = dup(STDERR_FILENO);
     }
 
+  v = getenv("XALT_COLLECTOR");
+  xalt_collector = (v && strcmp(v,"yes") == 0);
+
   v = getenv("__XALT_INITIAL_STATE__");
   if (xalt_tracing)
     {
@@ -330,6 +390,23 @@ void myinit(int argc, char **argv)
       return;
     }
 
+  /***********************************************************
+   * Test 1b: Is the executable known to be a SKIP?
+   * The path and hostname verdicts are cached in XALT_TMPDIR
+   * so a program on the SKIP list is rejected here.
+   ***********************************************************/
+
+  open_decision_cache();
+  get_abspath(exec_path,sizeof(exec_path));
+  path_results = cached_decision('P', exec_path);
+  if (path_results == SKIP)
+    {
+      DEBUG1(stderr,"    executable: \"%s\" is rejected (cached)\n", exec_path);
+      reject_flag = XALT_PATH;
+      unsetenv("XALT_RUN_UUID");
+      return;
+    }
+
 
   /***********************************************************
    * Test 2: MPI Rank > 0?:
@@ -356,8 +433,13 @@ void myinit(int argc, char **argv)
       exit(EXIT_FAILURE);
     }
 
-  results = HOSTNAME_PARSER(u.nodename);
-  HOSTNAME_PARSER_CLEANUP();
+  results = cached_decision('H', u.nodename);
+  if (results == 0)
+    {
+      results = HOSTNAME_PARSER(u.nodename);
+      HOSTNAME_PARSER_CLEANUP();
+      cache_decision('H', u.nodename, results);
+    }
   if (results == SKIP)
     {
       DEBUG1(stderr,"    hostname: \"%s\" is rejected\n",u.nodename);
@@ -389,10 +471,12 @@ void myinit(int argc, char **argv)
   if (my_size < 1L)
     my_size = 1L;
 
-  /* Get full absolute path to executable */
-  get_abspath(exec_path,sizeof(exec_path));
-  path_results = keep_path(exec_path);
-  path_parser_cleanup();
+  if (path_results == 0)
+    {
+      path_results = keep_path(exec_path);
+      path_parser_cleanup();
+      cache_decision('P', exec_path, path_results);
+    }
   
   if (path_results == SKIP)
     {
@@ -429,52 +513,31 @@ void myinit(int argc, char **argv)
 
   setenv("__XALT_INITIAL_STATE__",STR(STATE),1);
 
-  my_syshost = xalt_syshost();
-
-  /* Build a json version of the user's command line. */
-
-  /* Calculate size of buffer*/
-  int sz = 0;
-  for (i = 0; i < argc; ++i)
-    sz += strlen(argv[i]);
-
-  /* this size formula uses 3 facts:
-   *   1) if every character was a utf-16 character that is four bytes converts to 12 (sz*3)
-   *   2) Each entry has two quotes and a space (argc*3)
-   *   3) There are a pair of square brackets and a null byte (+3)
+  /* A scalar program that is sampled is usually not recorded.  With
+   * XALT_LAZY_SCALAR=yes myinit() only keeps what the sampling decision
+   * needs (the start time, argv and a random number) and myfini() builds
+   * the rest for the runs that are kept.
    */
+  v = getenv("XALT_SCALAR_SAMPLING");
+  if (!v)
+    v = getenv("XALT_SCALAR_AND_SPSR_SAMPLING");
+  int scalar_sampling = (v && strcmp(v,"yes") == 0);
 
-  sz = sz*3 + argc*3 + 3;
-
-  usr_cmdline = (char *) malloc(sz);
-  p	      = &usr_cmdline[0];
-  *p++        = '[';
-  for (i = 0; i < argc; ++i)
-    {
-      *p++ = '"';
-      const char* qs  = xalt_quotestring(argv[i]);
-      int         len = strlen(qs);
-      memcpy(p,qs,len);
-      p += len;
-      *p++= '"';
-      *p++= ',';
-    }
-  *--p = ']';
-  *++p = '\0';
-
-  int qsLen   = p - usr_cmdline;
-
-  if (p > &usr_cmdline[sz])
-    {
-      fprintf(stderr,"XALT: Failure in building user command line json string!\n");
-      reject_flag = XALT_BAD_JSON_STR;
-      unsetenv("XALT_RUN_UUID");
-      return;
-    }
-  xalt_quotestring_free();
-  b64_cmdline = base64_encode(usr_cmdline, qsLen, &b64_len);
-
-  build_uuid(uuid_str);
+  v = getenv("XALT_LAZY_SCALAR");
+  if (!v)
+    v = XALT_LAZY_SCALAR;
+  lazy_scalar = (scalar_sampling && xalt_kind == BIT_SCALAR && strcasecmp(v,"yes") == 0);
+  my_argc     = argc;
+  my_argv     = argv;
+
+  /* getopt() permutes argv and setproctitle() style code moves it, so
+   * myfini() works from a copy of the pointers.  The strings themselves
+   * are not copied: one that the program rewrites in place is recorded
+   * as it is at the end. */
+  if (lazy_scalar && (my_argv = (char **) malloc((argc + 1)*sizeof(char *))) != NULL)
+    memcpy(my_argv, argv, (argc + 1)*sizeof(char *));
+  else
+    my_argv = argv;
 
 #if USE_DCGM || USE_NVML
   /* This code will only ever be active in 64 bit mode and not 32 bit mode */
@@ -537,6 +600,8 @@ void myinit(int argc, char **argv)
               break;
             }
 
+          if (uuid_str[0] == '\0')
+            build_uuid(uuid_str);
           result = dcgmJobStartStats(dcgm_handle, (dcgmGpuGrp_t)DCGM_GROUP_ALL_GPUS, uuid_str);
           if (result != DCGM_ST_OK)
             {
@@ -574,104 +639,54 @@ void myinit(int argc, char **argv)
   start_time = epoch();
   frac_time  = start_time - (long) (start_time);
 
-  /**********************************************************
-   * Save LD_PRELOAD and clear it before running
-   * xalt_run_submission.
-   *********************************************************/
-
-  p = getenv("LD_PRELOAD");
-  if (p)
-    ld_preload_strp = strdup(p);
-
-  unsetenv("LD_PRELOAD");
-
-  const char * blank = " ";
-
-  char * env_path = getenv("PATH");
-  if (!env_path)
-    {
-      pathArg = (char *) malloc(2);
-      memcpy(pathArg,blank,2);
-    }
-  else
-    {
-      int ilen = 0;
-      int plen = strlen(env_path);
-      pathArg  = (char *) malloc(8 + plen + 2);
-      memcpy(&pathArg[ilen], "--path \"", 8); ilen += 8;
-      memcpy(&pathArg[ilen], env_path, plen); ilen += plen;
-      memcpy(&pathArg[ilen], "\"", 2);
-    }
-
-  char * env_ldlibpath = getenv("LD_LIBRARY_PATH");
-  if (!env_ldlibpath)
-    {
-      ldLibPathArg = (char *) malloc(2);
-      memcpy(ldLibPathArg,blank,2);
-    }
-  else
-    {
-      int ilen     = 0;
-      int plen     = strlen(env_ldlibpath);
-      ldLibPathArg = (char *) malloc(14 + plen + 2);
-      memcpy(&ldLibPathArg[ilen], "--ld_libpath \"", 14); ilen += 14;
-      memcpy(&ldLibPathArg[ilen], env_ldlibpath, plen);   ilen += plen;
-      memcpy(&ldLibPathArg[ilen], "\"", 2);
-    }
-
-  /* Push XALT_RUN_UUID, XALT_DATE_TIME into the environment so that things like
-   * R and python can know what job and what start time of the this run is.
-   */
-
-  setenv("XALT_RUN_UUID",uuid_str,1);
-  time_t my_time = start_time;
-  
-  strftime(dateStr, DATESZ, "%Y_%m_%d_%H_%M_%S",localtime(&my_time));
-  sprintf(fullDateStr,"%s_%d",dateStr, (int) (frac_time*10000.0));
-
-  setenv("XALT_DATE_TIME",fullDateStr,1);
-  setenv("XALT_DIR",XALT_DIR,1);
-
   pid  = getpid();
   ppid = getppid();
 
-  // This routine returns either "FALSE" for nothing found or the watermark.
-  xalt_vendor_note(&watermark, xalt_tracing);
-
-  // Now base64 encode the watermark so it can be safely passed thru a system call.
-  b64_watermark = base64_encode(watermark, strlen(watermark), &b64_wm_len);
-
   /* 
    * XALT is only recording the end record for scalar executables and
    * not the start record.
    */
 
-  if (run_mask & BIT_SCALAR)
+  if ((run_mask & BIT_SCALAR) && scalar_sampling)
     {
-      v = getenv("XALT_SCALAR_SAMPLING");
-      if (!v)
-	v = getenv("XALT_SCALAR_AND_SPSR_SAMPLING");
+      unsigned int a    = (unsigned int) clock();
+      unsigned int b    = (unsigned int) time(NULL);
+      unsigned int c    = (unsigned int) getpid();
+      unsigned int seed = mix(a,b,c);
 
-      if (v && strcmp(v,"yes") == 0)
-	{
-	  unsigned int a    = (unsigned int) clock();
-	  unsigned int b    = (unsigned int) time(NULL);
-	  unsigned int c    = (unsigned int) getpid();
-	  unsigned int seed = mix(a,b,c);
+      srand(seed);
+      my_rand           = (double) rand()/(double) RAND_MAX;
+    }
 
-	  srand(seed);
-	  my_rand	    = (double) rand()/(double) RAND_MAX;
-	}
+  if (lazy_scalar)
+    {
+      DEBUG1(stderr,"    -> Lazy scalar record (my_rand: %g): it is built in myfini() if the run is kept\n}\n\n",
+             my_rand);
+    }
+  else if (build_run_state(argc, argv) != 0)
+    {
+      reject_flag = XALT_BAD_JSON_STR;
+      unsetenv("XALT_RUN_UUID");
+      return;
     }
 
-  sprintf(&rand_str[0],"%10.6f",my_rand);
-  setenv("XALT_RANDOM_NUMBER",rand_str,1);
+  /**********************************************************
+   * Save LD_PRELOAD and clear it before running
+   * xalt_run_submission.
+   *********************************************************/
 
-  exec_pathQ = strdup(xalt_quotestring(exec_path));
-  xalt_quotestring_free();
+  p = lazy_scalar ? NULL : getenv("LD_PRELOAD");
+  if (p)
+    {
+      ld_preload_strp = strdup(p);
+      unsetenv("LD_PRELOAD");
+    }
 
   if ( run_mask & BIT_MPI)  
     {
+      /* Only the start record needs the library list now: an end
+       * record walks the libraries in myfini(). */
+      add_loaded_libs();
 
       const char * run_submission = XALT_DIR "/libexec/xalt_run_submission";
       int runable = access(run_submission, X_OK);
@@ -686,26 +701,30 @@ void myinit(int argc, char **argv)
         }
       run_submission_exists = 1;
 
+      char * argA[ARGSZ];
+      char   numA[9][NUMSZ];
+      double t_launch = 0.0;
+
       if (xalt_tracing || xalt_run_tracing)
         {
-	  char * cmd2;
-          asprintf(&cmd2, "LD_LIBRARY_PATH=\"%s\" PATH=\"%s\" \"%s\" --interfaceV %s --pid %d --ppid %d --syshost \"%s\" --start \"%.4f\" --end 0 --exec \"%s\" --ntasks %ld"
-                   " --kind \"%s\" --uuid \"%s\" --prob %g --ngpus 0 --watermark \"%s\" %s %s -- %s", CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH, run_submission, XALT_INTERFACE_VERSION,
-		   pid, ppid, my_syshost, start_time, exec_pathQ, my_size, xalt_run_short_descriptA[xalt_kind], uuid_str, probability, watermark, pathArg, ldLibPathArg,
-		   usr_cmdline);
-          fprintf(stderr, "  Recording state at beginning of %s user program:\n    %s\n\n}\n\n",
+          encode_argv_strings();
+          build_submission_argv(run_submission, 0.0, watermark, usr_cmdline, -1, numA, argA);
+          char * cmd2 = submission_argv_str(argA);
+          fprintf(stderr, "  Recording state at beginning of %s user program:\n    %s\n",
                   xalt_run_short_descriptA[run_mask], cmd2);
-	  free(cmd2);
+          free(cmd2);
+        }
+      if (xalt_collector && push_to_collector(0.0, &t_launch) == 0)
+        {
+          DEBUG1(stderr, "    -> handed start record to xalt_collectord in %.6f seconds\n\n}\n\n", t_launch);
+        }
+      else
+        {
+          spawn_run_submission(run_submission, 0.0, &t_launch);
+          DEBUG1(stderr, "    -> launched xalt_run_submission in %.6f seconds\n\n}\n\n", t_launch);
         }
-      asprintf(&cmdline, "LD_LIBRARY_PATH=\"%s\" PATH=\"%s\" \"%s\" --interfaceV %s --pid %d --ppid %d --syshost \"%s\" --start \"%.4f\" --end 0 --exec \"%s\" --ntasks %ld"
-	       " --kind \"%s\" --uuid \"%s\" --prob %g --ngpus 0 --watermark \"%s\" %s %s -- %s", CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH, run_submission, XALT_INTERFACE_VERSION,
-	       pid, ppid, my_syshost, start_time, exec_pathQ, my_size, xalt_run_short_descriptA[xalt_kind], uuid_str, probability, b64_watermark, pathArg, ldLibPathArg,
-	       b64_cmdline);
-
-      system(cmdline);
-      free(cmdline);
     }
-  else
+  else if (! lazy_scalar)
     {
       DEBUG2(stderr,"    -> XALT is build to %s, Current %s -> Not producing a start record\n}\n\n",
              xalt_build_descriptA[build_mask], xalt_run_descriptA[run_mask]);
@@ -748,7 +767,137 @@ void myinit(int argc, char **argv)
             sigaction(signum, &action, NULL);
         }
     }
+
+  /************************************************************
+   * With XALT_FORK_SUMMARY=yes the children that fork() makes
+   * without exec() count themselves in a shared page and the end
+   * record reports them as num_forks.
+   *********************************************************/
+  v = getenv("XALT_FORK_SUMMARY");
+  if (v && strcmp(v,"yes") == 0)
+    {
+      void * page = mmap(NULL, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (page != MAP_FAILED)
+        fork_count = (uint32_t *) page;
+    }
+}
+
+static void after_fork_in_child()
+{
+  forked_child = 1;
 }
+/* Build what the records need beyond the start time: the json
+ * version of the command line, the uuid, the copies of PATH and
+ * LD_LIBRARY_PATH and the watermark.  This is done by myinit() or, for a
+ * lazy scalar record, by myfini() once the run is known to be kept.
+ * Returns -1 when the command line cannot be built.
+ */
+static int build_run_state(int argc, char ** argv)
+{
+  char   dateStr[DATESZ];
+  char   fullDateStr[DATESZ];
+  char   rand_str[20];
+  char * p;
+  int    i;
+
+  my_syshost = xalt_syshost();
+
+  /* Build a json version of the user's command line. */
+
+  /* Calculate size of buffer*/
+  int sz = 0;
+  for (i = 0; i < argc; ++i)
+    sz += strlen(argv[i]);
+
+  /* this size formula uses 3 facts:
+   *   1) if every character was a utf-16 character that is four bytes converts to 12 (sz*3)
+   *   2) Each entry has two quotes and a space (argc*3)
+   *   3) There are a pair of square brackets and a null byte (+3)
+   */
+
+  sz = sz*3 + argc*3 + 3;
+
+  usr_cmdline = (char *) malloc(sz);
+  p	      = &usr_cmdline[0];
+  *p++        = '[';
+  for (i = 0; i < argc; ++i)
+    {
+      *p++ = '"';
+      const char* qs  = xalt_quotestring(argv[i]);
+      int         len = strlen(qs);
+      memcpy(p,qs,len);
+      p += len;
+      *p++= '"';
+      *p++= ',';
+    }
+  *--p = ']';
+  *++p = '\0';
+
+  if (p > &usr_cmdline[sz])
+    {
+      fprintf(stderr,"XALT: Failure in building user command line json string!\n");
+      return -1;
+    }
+  xalt_quotestring_free();
+
+  /* The DCGM job stats in myinit() may have needed the uuid already. */
+  if (uuid_str[0] == '\0')
+    build_uuid(uuid_str);
+
+  /* Save copies of PATH and LD_LIBRARY_PATH: they are passed to
+   * xalt_run_submission as arguments and the user's program is free to
+   * change its environment before myfini() is called.
+   */
+
+  char * env_path = getenv("PATH");
+  if (env_path)
+    pathArg = strdup(env_path);
+
+  char * env_ldlibpath = getenv("LD_LIBRARY_PATH");
+  if (env_ldlibpath)
+    ldLibPathArg = strdup(env_ldlibpath);
+
+  /* Push XALT_RUN_UUID, XALT_DATE_TIME into the environment so that things like
+   * R and python can know what job and what start time of the this run is.
+   */
+
+  setenv("XALT_RUN_UUID",uuid_str,1);
+  time_t my_time = start_time;
+  
+  strftime(dateStr, DATESZ, "%Y_%m_%d_%H_%M_%S",localtime(&my_time));
+  sprintf(fullDateStr,"%s_%d",dateStr, (int) (frac_time*10000.0));
+
+  setenv("XALT_DATE_TIME",fullDateStr,1);
+  setenv("XALT_DIR",XALT_DIR,1);
+
+  sprintf(&rand_str[0],"%10.6f",my_rand);
+  setenv("XALT_RANDOM_NUMBER",rand_str,1);
+
+  // This routine returns either "FALSE" for nothing found or the watermark.
+  xalt_vendor_note(&watermark, xalt_tracing);
+
+  return 0;
+}
+
+/* The quoted exec path and the base64 versions of the command line and
+ * the watermark are only needed when the strings go through argv or
+ * the collector's ring instead of a payload. */
+static void encode_argv_strings()
+{
+  if (exec_pathQ)
+    return;
+
+  // Both encodings share one buffer.
+  int cmdLen    = strlen(usr_cmdline);
+  int wmLen     = strlen(watermark);
+  b64_cmdline   = (char *) malloc(BASE64_ENCODED_LEN(cmdLen) + 1 + BASE64_ENCODED_LEN(wmLen) + 1);
+  b64_len       = base64_encode_to(b64_cmdline, usr_cmdline, cmdLen);
+  b64_watermark = &b64_cmdline[b64_len + 1];
+  b64_wm_len    = base64_encode_to(b64_watermark, watermark, wmLen);
+  exec_pathQ    = strdup(xalt_quotestring(exec_path));
+  xalt_quotestring_free();
+}
+
 void wrapper_for_myfini(int signum)
 {
   struct sigaction action;
@@ -763,7 +912,6 @@ void wrapper_for_myfini(int signum)
 void myfini()
 {
   FILE * my_stderr = NULL;
-  char * cmdline;
   double run_time;
   int    xalt_err = xalt_tracing || xalt_run_tracing;
 
@@ -776,12 +924,34 @@ void myfini()
       DEBUG1(my_stderr,"\nmyfini(%s){\n", STR(STATE));
     }
 
+  /* A forked child leaves the record (and the run's files) to its parent.
+   * Its own audit log, made when it loaded a library, is its to remove. */
+  if (forked_child || getpid() != pid)
+    {
+      if (fork_count && reject_flag == XALT_SUCCESS)
+        __sync_fetch_and_add(fork_count, 1);
+      remove_audit_log();
+      DEBUG1(my_stderr,"    -> exiting because this is a forked child of pid: %d\n}\n\n", pid);
+      if (xalt_err)
+	{
+	  fclose(my_stderr);
+	  close(errfd);
+	  close(STDERR_FILENO);
+	}
+      return;
+    }
+
   /* Stop tracking if my mpi rank is not zero or the path was rejected. */
   if (reject_flag != XALT_SUCCESS)
     {
       if (xalt_kind == BIT_PKGS)
         remove_xalt_tmpdir(&uuid_str[0]);
 
+      /* A WRONG_STATE or RUN_TWICE copy shares the process with the
+       * copy that owns the run and must leave the audit log to it. */
+      if (reject_flag != XALT_WRONG_STATE && reject_flag != XALT_RUN_TWICE)
+        remove_audit_log();
+
       DEBUG2(my_stderr,"    -> exiting because reject is set to: %s for program: %s\n}\n\n",
 	     xalt_reasonA[reject_flag], exec_path);
       if (xalt_err)
@@ -970,6 +1140,7 @@ void myfini()
 	      DEBUG4(my_stderr, "    -> exiting because scalar sampling. "
 		     "run_time: %g, (my_rand: %g > prob: %g) for program: %s\n}\n\n",
 		     run_time, my_rand, probability, exec_path);
+	      remove_audit_log();
 	      if (xalt_err) 
 		{
 		  fclose(my_stderr);
@@ -983,37 +1154,59 @@ void myfini()
 		   run_time, my_rand, probability, exec_path);
 	}
     }
+
+  /* The run is kept: build what a lazy scalar record skipped in myinit(). */
+  if (lazy_scalar && build_run_state(my_argc, my_argv) != 0)
+    {
+      DEBUG1(my_stderr, "    -> exiting because the command line could not be built for program: %s\n}\n\n",
+             exec_path);
+      reject_flag = XALT_BAD_JSON_STR;
+      remove_audit_log();
+      if (xalt_err) 
+        {
+          fclose(my_stderr);
+          close(errfd);
+          close(STDERR_FILENO);
+        }
+      return;
+    }
   
+  add_loaded_libs();
+
   const char * run_submission = XALT_DIR "/libexec/xalt_run_submission";
   int runable = (run_submission_exists == 1) ? 1 : access(run_submission, X_OK);
   if (runable == -1)
     {
       DEBUG1(my_stderr, "    -> Quitting => Cannot find xalt_run_submission: %s\n}\n\n", run_submission);
       reject_flag = XALT_MISSING_RUN_SUBMISSION;
+      remove_audit_log();
     }
   else
     {
+      char * argA[ARGSZ];
+      char   numA[9][NUMSZ];
+      double t_launch = 0.0;
+
       if (xalt_tracing || xalt_run_tracing )
         {
-          int    dLen;
-	  char * cmd2    = NULL;
-          char * decoded = (char *) base64_decode(b64_cmdline, strlen(b64_cmdline), &dLen);
-          asprintf(&cmd2, "LD_LIBRARY_PATH=\"%s\" PATH=\"%s\" \"%s\" --interfaceV %s --pid %d --ppid %d --syshost \"%s\" --start \"%.4f\" --end \"%.4f\" --exec \"%s\""
-                   " --ntasks %ld --kind \"%s\" --uuid \"%s\" --prob %g --ngpus %d --watermark \"%s\" %s %s -- %s", CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH, run_submission,
-		   XALT_INTERFACE_VERSION, pid, ppid, my_syshost, start_time, end_time, exec_pathQ, my_size, xalt_run_short_descriptA[xalt_kind], uuid_str,
-		   probability, num_gpus, watermark, pathArg, ldLibPathArg, decoded);
-          //		   probability, num_gpus, watermark, pathArg, ldLibPathArg, decoded);
+          encode_argv_strings();
+          build_submission_argv(run_submission, end_time, watermark, usr_cmdline, -1, numA, argA);
+          char * cmd2 = submission_argv_str(argA);
 	  fprintf(my_stderr,"  len: %u, b64_cmd: %s\n", (unsigned int) strlen(b64_cmdline), b64_cmdline);
-          fprintf(my_stderr,"  Recording State at end of %s user program:\n    %s\n}\n\n",
+          fprintf(my_stderr,"  Recording State at end of %s user program:\n    %s\n",
                   xalt_run_short_descriptA[run_mask], cmd2);
 	  fflush(my_stderr);
+          free(cmd2);
+        }
+      if (xalt_collector && push_to_collector(end_time, &t_launch) == 0)
+        {
+          DEBUG1(my_stderr, "    -> handed end record to xalt_collectord in %.6f seconds\n}\n\n", t_launch);
+        }
+      else
+        {
+          spawn_run_submission(run_submission, end_time, &t_launch);
+          DEBUG1(my_stderr, "    -> launched xalt_run_submission in %.6f seconds\n}\n\n", t_launch);
         }
-      asprintf(&cmdline, "LD_LIBRARY_PATH=\"%s\" PATH=\"%s\" \"%s\" --interfaceV %s --pid %d --ppid %d --syshost \"%s\" --start \"%.4f\" --end \"%.4f\" --exec \"%s\""
-               " --ntasks %ld --kind \"%s\" --uuid \"%s\" --prob %g --ngpus %d --watermark \"%s\" %s %s -- %s", CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH, run_submission,
-	       XALT_INTERFACE_VERSION, pid, ppid, my_syshost, start_time, end_time, exec_pathQ, my_size, xalt_run_short_descriptA[xalt_kind], uuid_str,
-	       probability, num_gpus, b64_watermark, pathArg, ldLibPathArg, b64_cmdline);
-
-      system(cmdline);
     }
 
   if (xalt_err) 
@@ -1127,6 +1320,460 @@ static  double scalar_program_sample_probability(double runtime)
 }  
 
 
+/* Fill argA with the arguments for xalt_run_submission. The numeric
+ * arguments are formatted into numA so argA is only valid as long as
+ * numA is.  When payload_fd is not -1 the strings are in the payload
+ * and only the descriptor is passed. */
+static void build_submission_argv(const char * run_submission, double end_time, const char * wm,
+                                  const char * cmdline, int payload_fd, char numA[][NUMSZ],
+                                  char ** argA)
+{
+  int i = 0;
+
+  snprintf(numA[0], NUMSZ, "%d",   pid);
+  snprintf(numA[1], NUMSZ, "%d",   ppid);
+  snprintf(numA[2], NUMSZ, "%.4f", start_time);
+  if (end_time > 0.0)
+    snprintf(numA[3], NUMSZ, "%.4f", end_time);
+  else
+    snprintf(numA[3], NUMSZ, "0");
+  snprintf(numA[4], NUMSZ, "%ld",  my_size);
+  snprintf(numA[5], NUMSZ, "%g",   probability);
+  snprintf(numA[6], NUMSZ, "%d",   num_gpus);
+  snprintf(numA[7], NUMSZ, "%d",   payload_fd);
+  snprintf(numA[8], NUMSZ, "%u",   fork_count ? *fork_count : 0U);
+
+  argA[i++] = (char *) run_submission;
+  argA[i++] = "--interfaceV"; argA[i++] = XALT_INTERFACE_VERSION;
+  argA[i++] = "--pid";        argA[i++] = numA[0];
+  argA[i++] = "--ppid";       argA[i++] = numA[1];
+  argA[i++] = "--syshost";    argA[i++] = (char *) my_syshost;
+  argA[i++] = "--start";      argA[i++] = numA[2];
+  argA[i++] = "--end";        argA[i++] = numA[3];
+  argA[i++] = "--ntasks";     argA[i++] = numA[4];
+  argA[i++] = "--kind";       argA[i++] = (char *) xalt_run_short_descriptA[xalt_kind];
+  argA[i++] = "--uuid";       argA[i++] = uuid_str;
+  argA[i++] = "--prob";       argA[i++] = numA[5];
+  argA[i++] = "--ngpus";      argA[i++] = numA[6];
+  if (fork_count && end_time > 0.0)
+    {
+      argA[i++] = "--nforks";     argA[i++] = numA[8];
+    }
+  if (payload_fd >= 0)
+    {
+      argA[i++] = "--payload_fd"; argA[i++] = numA[7];
+      argA[i]   = NULL;
+      return;
+    }
+  argA[i++] = "--exec";       argA[i++] = exec_pathQ;
+  argA[i++] = "--watermark";  argA[i++] = (char *) wm;
+  if (pathArg)
+    {
+      argA[i++] = "--path";       argA[i++] = pathArg;
+    }
+  if (ldLibPathArg)
+    {
+      argA[i++] = "--ld_libpath"; argA[i++] = ldLibPathArg;
+    }
+  if (lib_list())
+    {
+      argA[i++] = "--libs";       argA[i++] = (char *) lib_list();
+    }
+  argA[i++] = "--";
+  argA[i++] = (char *) cmdline;
+  argA[i]   = NULL;
+}
+
+/* Only used for tracing: join argA into a single string. */
+static char * submission_argv_str(char ** argA)
+{
+  int    i;
+  int    len = 1;
+  char * s;
+  char * p;
+
+  for (i = 0; argA[i]; ++i)
+    len += strlen(argA[i]) + 3;
+
+  s = p = (char *) malloc(len);
+  for (i = 0; argA[i]; ++i)
+    {
+      int quote = (argA[i][0] != '-' && argA[i][0] != '[');
+      if (quote) *p++ = '"';
+      len = strlen(argA[i]);
+      memcpy(p, argA[i], len);
+      p += len;
+      if (quote) *p++ = '"';
+      *p++ = ' ';
+    }
+  if (p > s)
+    p--;
+  *p = '\0';
+  return s;
+}
+
+/* Run xalt_run_submission directly (no /bin/sh) with the LD_LIBRARY_PATH
+ * and PATH that XALT was built with and wait for it to finish.  The
+ * strings of the record are handed over in a payload (a memfd or a
+ * pipe) unless XALT_PAYLOAD=no or no payload can be made; then they
+ * are quoted and base64 encoded into argv as before. */
+static int spawn_run_submission(const char * run_submission, double end_time, double * t_launch)
+{
+  int          status;
+  int          payload_fd = -1;
+  char *       argA[ARGSZ];
+  char         numA[9][NUMSZ];
+  const char * strA[XALT_PAYLOAD_NSTR];
+  const char * v          = getenv("XALT_PAYLOAD");
+  char**       envp       = xalt_spawn_env(CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH);
+  if (envp == NULL)
+    return -1;
+
+  if (v == NULL || strcmp(v, "no") != 0)
+    {
+      strA[XALT_PAYLOAD_EXEC]      = exec_path;
+      strA[XALT_PAYLOAD_WATERMARK] = watermark;
+      strA[XALT_PAYLOAD_CMDLINE]   = usr_cmdline;
+      strA[XALT_PAYLOAD_PATH]      = pathArg;
+      strA[XALT_PAYLOAD_LDLIBPATH] = ldLibPathArg;
+      strA[XALT_PAYLOAD_LIBS]      = lib_list();
+      payload_fd = xalt_payload_create(strA, XALT_PAYLOAD_NSTR);
+    }
+  if (payload_fd >= 0)
+    build_submission_argv(run_submission, end_time, NULL, NULL, payload_fd, numA, argA);
+  else
+    {
+      encode_argv_strings();
+      build_submission_argv(run_submission, end_time, b64_watermark, b64_cmdline, -1, numA, argA);
+    }
+
+  status = xalt_spawn(run_submission, argA, envp, 1, t_launch);
+  if (payload_fd >= 0)
+    close(payload_fd);
+  xalt_spawn_env_free(envp);
+  return status;
+}
+
+/* Hand the record to xalt_collectord when one is running for this user.
+ * An end record waits (at most XALT_COLLECTOR_WAIT seconds) until the
+ * collector has read /proc/$pid since this process is about to go away.
+ * Returns -1 when the caller has to run xalt_run_submission instead. */
+static int push_to_collector(double end_time, double * t_launch)
+{
+  int             status;
+  double          wait_time = 0.0;
+  double          t0        = epoch();
+  char *          name      = xalt_ring_name();
+  xalt_ring_t *   ring      = xalt_ring_attach(name);
+  xalt_ring_rec_t rec;
+  const char *    strA[XALT_RING_NSTR];
+  uint32_t        lenA[XALT_RING_NSTR];
+  char **         envp;
+  char *          envBlk;
+  size_t          envLen    = 0;
+  int             i;
+
+  free(name);
+  if (ring == NULL)
+    return -1;
+
+  /* The collector builds envT from the environment xalt_run_submission
+   * would get (this program's at this point), not from /proc/$pid. */
+  envp = xalt_spawn_env(CXX_LD_LIBRARY_PATH, XALT_SYSTEM_PATH);
+  if (envp == NULL)
+    {
+      xalt_ring_detach(ring);
+      return -1;
+    }
+  for (i = 0; envp[i]; ++i)
+    envLen += strlen(envp[i]) + 1;
+  envBlk = (char *) malloc(envLen + 1);
+  if (envBlk == NULL)
+    {
+      xalt_spawn_env_free(envp);
+      xalt_ring_detach(ring);
+      return -1;
+    }
+  envLen = 0;
+  for (i = 0; envp[i]; ++i)
+    {
+      size_t len = strlen(envp[i]) + 1;
+      memcpy(&envBlk[envLen], envp[i], len);
+      envLen += len;
+    }
+  xalt_spawn_env_free(envp);
+
+  encode_argv_strings();
+  memset(&rec, 0, sizeof(rec));
+  rec.start_time  = start_time;
+  rec.end_time    = end_time;
+  rec.probability = probability;
+  rec.ntasks      = my_size;
+  rec.pid         = pid;
+  rec.ppid        = ppid;
+  rec.ngpus       = num_gpus;
+  strncpy(rec.kind, xalt_run_short_descriptA[xalt_kind], sizeof(rec.kind) - 1);
+  strncpy(rec.uuid, uuid_str,                            sizeof(rec.uuid) - 1);
+
+  strA[XALT_RING_EXEC]      = exec_pathQ;
+  strA[XALT_RING_SYSHOST]   = my_syshost;
+  strA[XALT_RING_PATH]      = pathArg;
+  strA[XALT_RING_LDLIBPATH] = ldLibPathArg;
+  strA[XALT_RING_WATERMARK] = b64_watermark;
+  strA[XALT_RING_CMDLINE]   = b64_cmdline;
+  strA[XALT_RING_LIBS]      = lib_list();
+  if (strA[XALT_RING_LIBS] && libListLen > XALT_RING_SLOT_SZ/2)
+    strA[XALT_RING_LIBS] = NULL;     /* the collector reads /proc instead */
+  strA[XALT_RING_ENV]       = envBlk;
+  for (i = 0; i < XALT_RING_NSTR; ++i)
+    lenA[i] = strA[i] ? (uint32_t) strlen(strA[i]) : 0;
+  lenA[XALT_RING_ENV]       = (uint32_t) envLen;
+
+  if (end_time > 0.0)
+    {
+      const char * v = getenv("XALT_COLLECTOR_WAIT");
+      wait_time = v ? strtod(v, (char **) NULL) : XALT_RING_WAIT;
+    }
+
+  status = xalt_ring_push(ring, &rec, strA, lenA, wait_time);
+  free(envBlk);
+  xalt_ring_detach(ring);
+  *t_launch = epoch() - t0;
+  return status;
+}
+
+#ifdef __linux__
+static uint64_t lib_hash(const char * name, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL;    /* FNV-1a */
+  size_t   i;
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char) name[i]) * 1099511628211ULL;
+  return h;
+}
+
+/* Return the slot of name in libSetA: either the slot that has it or
+ * the empty slot where it goes. */
+static libSlot_t * lib_slot(libSlot_t * setA, size_t cap, uint64_t h, const char * name, size_t len)
+{
+  size_t i = (size_t) h & (cap - 1);
+  while (setA[i].len != 0 &&
+         (setA[i].hash != h || setA[i].len != len || memcmp(&libListArg[setA[i].off], name, len) != 0))
+    i = (i + 1) & (cap - 1);
+  return &setA[i];
+}
+
+/* Keep libSetA at most half full.  Returns -1 when out of memory. */
+static int lib_set_grow()
+{
+  size_t      cap, i;
+  libSlot_t * setA;
+
+  if (2*(libSetCnt + 1) <= libSetCap)
+    return 0;
+  cap  = libSetCap ? 2*libSetCap : 64;
+  setA = (libSlot_t *) calloc(cap, sizeof(libSlot_t));
+  if (setA == NULL)
+    return -1;
+  for (i = 0; i < libSetCap; i++)
+    if (libSetA[i].len != 0)
+      *lib_slot(setA, cap, libSetA[i].hash, &libListArg[libSetA[i].off], libSetA[i].len) = libSetA[i];
+  free(libSetA);
+  libSetA   = setA;
+  libSetCap = cap;
+  return 0;
+}
+
+/* dl_iterate_phdr() callback: add one loaded object to libListArg. */
+static int add_lib(struct dl_phdr_info * info, size_t size, void * data)
+{
+  char         resolved[PATH_MAX];
+  const char * name = info->dlpi_name;
+  libSlot_t *  slot;
+  uint64_t     h;
+  size_t       len;
+
+  /* The program itself has an empty name and the vdso has no path. */
+  if (name == NULL || name[0] != '/')
+    return 0;
+  if (strstr(strrchr(name, '/'), "libxalt_init.so"))
+    return 0;
+  if (realpath(name, resolved))
+    name = resolved;
+  if (strchr(name, ':'))
+    {
+      libListBad = 1;
+      return 0;
+    }
+
+  /* Skip it when it is already in the list. */
+  len = strlen(name);
+  h   = lib_hash(name, len);
+  if (libSetCap > 0 && lib_slot(libSetA, libSetCap, h, name, len)->len != 0)
+    return 0;
+  if (len > UINT32_MAX || lib_set_grow() != 0)
+    {
+      libListBad = 1;
+      return 0;
+    }
+
+  if (libListLen + len + 2 > libListCap)
+    {
+      size_t cap = 2*libListCap + len + 2;
+      char * q   = (char *) realloc(libListArg, cap);
+      if (q == NULL)
+        {
+          libListBad = 1;
+          return 0;
+        }
+      libListArg = q;
+      libListCap = cap;
+    }
+  if (libListLen > 0)
+    libListArg[libListLen++] = ':';
+  memcpy(&libListArg[libListLen], name, len + 1);
+
+  slot       = lib_slot(libSetA, libSetCap, h, name, len);
+  slot->hash = h;
+  slot->off  = (uint32_t) libListLen;
+  slot->len  = (uint32_t) len;
+  libSetCnt++;
+
+  libListLen += len;
+  return 0;
+}
+#endif
+
+/* Add the shared libraries that are loaded right now to libListArg so
+ * that xalt_run_submission does not have to read /proc/$pid/maps.  This
+ * is done where a record is built: in myinit() for an MPI start record
+ * and in myfini() for the end record, so a run that is not kept never
+ * pays for it.  A library dlclose()'d before the end is only listed when
+ * there was a start record. */
+static void add_loaded_libs()
+{
+#ifdef __linux__
+  dl_iterate_phdr(add_lib, NULL);
+#endif
+}
+
+/* The library list for xalt_run_submission or NULL when it has to read
+ * /proc/$pid/maps itself. */
+static const char * lib_list()
+{
+  if (libListBad || libListLen == 0 || libListLen > LIBLISTSZ)
+    return NULL;
+  return libListArg;
+}
+
+/* Remove the libxalt_audit.so log when no end record will read it.
+ * xalt_run_submission and xalt_collectord remove it after reading. */
+static void remove_audit_log()
+{
+  char         fn[PATH_MAX];
+  const char * v = getenv("LD_AUDIT");
+  if (v == NULL || strstr(v, "libxalt_audit.so") == NULL)
+    return;
+  snprintf(fn, sizeof(fn), XALT_AUDIT_FMT, XALT_TMPDIR, (unsigned int) getuid(), (int) getpid());
+  unlink(fn);
+}
+
+/*
+ * The decision cache: the verdicts (PKGS, KEEP or SKIP) of keep_path()
+ * and of the hostname parser, kept in the file
+ *
+ *     XALT_TMPDIR/XALT_decisions_<uid>_<generation>
+ *
+ * and shared by all the programs a user runs on the node.  The
+ * generation changes with every build of this file (and so with every
+ * change to config.py), which starts a new cache.  Each entry is the
+ * hash of the name with its verdict in the low two bits; entries are
+ * only ever added, with a compare and swap.  The file is per user so
+ * that nobody can change the verdicts for someone else's programs.
+ * XALT_DECISION_CACHE=no turns it off.
+ */
+
+static uint64_t decision_hash(uint64_t h, char kind, const char * name)
+{
+  const unsigned char * p = (const unsigned char *) name;
+  h = (h ^ (unsigned char) kind) * 1099511628211ULL;
+  for ( ; *p; ++p)
+    h = (h ^ *p) * 1099511628211ULL;
+  h &= ~3ULL;
+  return h ? h : 4;
+}
+
+static void open_decision_cache()
+{
+  char         fn[PATH_MAX];
+  struct stat  st;
+  size_t       sz = DECISION_SLOTS*sizeof(uint64_t);
+  const char * v  = getenv("XALT_DECISION_CACHE");
+  int          fd;
+  void *       p;
+
+  if (decisionA || (v && strcmp(v,"no") == 0))
+    return;
+
+  decision_gen = decision_hash(14695981039346656037ULL, 'G',
+                               XALT_GIT_VERSION " " STR(STATE) " " __DATE__ " " __TIME__ " " XALT_CONFIG_PY);
+  snprintf(fn, sizeof(fn), "%s/XALT_decisions_%u_%016llx", XALT_TMPDIR, (unsigned int) getuid(),
+           (unsigned long long) decision_gen);
+
+  fd = open(fn, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return;
+  if (fstat(fd, &st) != 0 || st.st_uid != getuid() ||
+      ((size_t) st.st_size < sz && ftruncate(fd, sz) != 0))
+    {
+      close(fd);
+      return;
+    }
+  p = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p != MAP_FAILED)
+    decisionA = (uint64_t *) p;
+}
+
+/* The cached verdict for name or 0 when there is none. */
+static xalt_parser cached_decision(char kind, const char * name)
+{
+  uint64_t h;
+  size_t   i;
+  int      j;
+
+  if (decisionA == NULL)
+    return 0;
+  h = decision_hash(decision_gen, kind, name);
+  for (i = h % DECISION_SLOTS, j = 0; j < DECISION_PROBES; ++j, i = (i + 1) % DECISION_SLOTS)
+    {
+      uint64_t e = __atomic_load_n(&decisionA[i], __ATOMIC_RELAXED);
+      if (e == 0)
+        break;
+      if ((e & ~3ULL) == h)
+        return (xalt_parser) (e & 3);
+    }
+  return 0;
+}
+
+static void cache_decision(char kind, const char * name, xalt_parser result)
+{
+  uint64_t h;
+  size_t   i;
+  int      j;
+
+  if (decisionA == NULL || result < PKGS || result > SKIP)
+    return;
+  h = decision_hash(decision_gen, kind, name);
+  for (i = h % DECISION_SLOTS, j = 0; j < DECISION_PROBES; ++j, i = (i + 1) % DECISION_SLOTS)
+    {
+      uint64_t e = 0;
+      if (__atomic_compare_exchange_n(&decisionA[i], &e, h | result, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ||
+          (e & ~3ULL) == h)
+        return;
+    }
+}
+
 #ifdef __MACH__
   __attribute__((section("__DATA,__mod_init_func"), used, aligned(sizeof(void*)))) __typeof__(myinit) *__init = myinit;
   __attribute__((section("__DATA,__mod_term_func"), used, aligned(sizeof(void*)))) __typeof__(myfini) *__fini = myfini;
@@ -32,11 +32,32 @@
 #define remove_xalt_tmpdir          PASTE2(__XALT_remove_xalt_tmpdir,         HIDE)
 #define base64_encode               PASTE2(__XALT_base64_encode,              HIDE)
 #define base64_decode               PASTE2(__XALT_base64_decode,              HIDE)
+#define base64_encode_to            PASTE2(__XALT_base64_encode_to,           HIDE)
+#define base64_decoded_len          PASTE2(__XALT_base64_decoded_len,         HIDE)
+#define base64_decode_to            PASTE2(__XALT_base64_decode_to,           HIDE)
 #define my_hostname_parser          PASTE2(__XALT_my_hostname_parser,         HIDE)
 #define my_hostname_parser_cleanup  PASTE2(__XALT_my_hostname_parser_cleanup, HIDE)
 #define xalt_fgets_alloc            PASTE2(__XALT_fgets_alloc,                HIDE)
+#define xalt_payload_create         PASTE2(__XALT_payload_create,             HIDE)
+#define xalt_payload_read           PASTE2(__XALT_payload_read,               HIDE)
 #define xalt_quotestring            PASTE2(__XALT_quotestring,                HIDE)
 #define xalt_quotestring_free       PASTE2(__XALT_quotestring_free,           HIDE)
+#define xalt_quotestring_to         PASTE2(__XALT_quotestring_to,             HIDE)
+#define xalt_quotestring_plain_len  PASTE2(__XALT_quotestring_plain_len,      HIDE)
+#define xalt_spawn                  PASTE2(__XALT_spawn,                      HIDE)
+#define xalt_spawn_env              PASTE2(__XALT_spawn_env,                  HIDE)
+#define xalt_spawn_env_free         PASTE2(__XALT_spawn_env_free,             HIDE)
+#define xalt_ring_name              PASTE2(__XALT_ring_name,                  HIDE)
+#define xalt_ring_attach            PASTE2(__XALT_ring_attach,                HIDE)
+#define xalt_ring_push              PASTE2(__XALT_ring_push,                  HIDE)
+#define xalt_ring_detach            PASTE2(__XALT_ring_detach,                HIDE)
+#define xalt_ring_create            PASTE2(__XALT_ring_create,                HIDE)
+#define xalt_ring_wait              PASTE2(__XALT_ring_wait,                  HIDE)
+#define xalt_ring_peek              PASTE2(__XALT_ring_peek,                  HIDE)
+#define xalt_ring_release           PASTE2(__XALT_ring_release,               HIDE)
+#define xalt_ring_empty             PASTE2(__XALT_ring_empty,                 HIDE)
+#define xalt_ring_destroy           PASTE2(__XALT_ring_destroy,               HIDE)
+#define xalt_ring_rec_str           PASTE2(__XALT_ring_rec_str,               HIDE)
 #define xalt_syshost                PASTE2(__XALT_syshost,                    HIDE)
 #define xalt_unquotestring          PASTE2(__XALT_unquotestring,              HIDE)
 #define xalt_vendor_note            PASTE2(__XALT_vendor_note,                HIDE)
@@ -0,0 +1,190 @@
+#define  _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "xalt_payload.h"
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+static int write_iov(int fd, struct iovec* iov, int cnt, size_t total)
+{
+  while (cnt > 0)
+    {
+      ssize_t w = writev(fd, iov, cnt);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        return -1;
+      total -= w;
+      while (cnt > 0 && (size_t) w >= iov->iov_len)
+        {
+          w -= iov->iov_len;
+          iov++;
+          cnt--;
+        }
+      if (cnt > 0)
+        {
+          iov->iov_base  = (char *) iov->iov_base + w;
+          iov->iov_len  -= w;
+        }
+    }
+  return total == 0 ? 0 : -1;
+}
+
+/* A memfd that can be sealed, or -1 when the kernel has none. */
+static int open_memfd()
+{
+#ifdef SYS_memfd_create
+  return (int) syscall(SYS_memfd_create, "xalt_payload", MFD_ALLOW_SEALING);
+#else
+  return -1;
+#endif
+}
+
+int xalt_payload_create(const char* strA[], int n)
+{
+  struct iovec iov[2*XALT_PAYLOAD_NSTR + 2];
+  uint32_t     lenA[XALT_PAYLOAD_NSTR + 1];
+  size_t       total = 8;
+  int          cnt   = 0;
+  int          i, fd;
+  int          pfd[2];
+
+  if (n > XALT_PAYLOAD_NSTR)
+    return -1;
+
+  lenA[0]              = (uint32_t) n;
+  iov[cnt].iov_base    = (void *) XALT_PAYLOAD_MAGIC;
+  iov[cnt++].iov_len   = 4;
+  iov[cnt].iov_base    = &lenA[0];
+  iov[cnt++].iov_len   = sizeof(uint32_t);
+  for (i = 0; i < n; i++)
+    {
+      size_t len         = strA[i] ? strlen(strA[i]) : 0;
+      lenA[i+1]          = strA[i] ? (uint32_t) len : XALT_PAYLOAD_NULL;
+      iov[cnt].iov_base  = &lenA[i+1];
+      iov[cnt++].iov_len = sizeof(uint32_t);
+      total             += sizeof(uint32_t) + len;
+      if (len > 0)
+        {
+          iov[cnt].iov_base  = (void *) strA[i];
+          iov[cnt++].iov_len = len;
+        }
+    }
+  if (total > XALT_PAYLOAD_MAX)
+    return -1;
+
+  fd = open_memfd();
+  if (fd >= 0)
+    {
+      if (write_iov(fd, iov, cnt, total) != 0 || lseek(fd, 0, SEEK_SET) != 0)
+        {
+          close(fd);
+          return -1;
+        }
+#ifdef F_ADD_SEALS
+      fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+      return fd;
+    }
+
+  /* No memfd: the whole payload has to fit in the pipe since nobody
+   * reads it until the child is running. */
+  if (pipe(pfd) != 0)
+    return -1;
+#ifdef F_SETPIPE_SZ
+  if (fcntl(pfd[1], F_GETPIPE_SZ) < (int) total)
+    fcntl(pfd[1], F_SETPIPE_SZ, (int) total);
+  if (fcntl(pfd[1], F_GETPIPE_SZ) < (int) total)
+#else
+  if (total > 4096)
+#endif
+    {
+      close(pfd[0]);
+      close(pfd[1]);
+      return -1;
+    }
+  if (write_iov(pfd[1], iov, cnt, total) != 0)
+    {
+      close(pfd[0]);
+      close(pfd[1]);
+      return -1;
+    }
+  close(pfd[1]);
+  return pfd[0];
+}
+
+int xalt_payload_read(int fd, char* strA[], int n)
+{
+  size_t   cap = 4096;
+  size_t   len = 0;
+  size_t   off = 8;
+  char*    buf = (char *) malloc(cap);
+  uint32_t sz;
+  int      i;
+
+  for (i = 0; i < n; i++)
+    strA[i] = NULL;
+
+  while (buf)
+    {
+      ssize_t r;
+      if (len == cap)
+        {
+          char* nbuf = (cap < XALT_PAYLOAD_MAX) ? (char *) realloc(buf, 2*cap) : NULL;
+          if (nbuf == NULL)
+            {
+              free(buf);
+              buf = NULL;
+              break;
+            }
+          buf  = nbuf;
+          cap *= 2;
+        }
+      r = read(fd, &buf[len], cap - len);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        break;
+      len += r;
+    }
+  close(fd);
+
+  if (buf == NULL || len < off || memcmp(buf, XALT_PAYLOAD_MAGIC, 4) != 0)
+    goto bad;
+  memcpy(&sz, &buf[4], sizeof(uint32_t));
+  if ((int) sz != n)
+    goto bad;
+
+  for (i = 0; i < n; i++)
+    {
+      if (len - off < sizeof(uint32_t))
+        goto bad;
+      memcpy(&sz, &buf[off], sizeof(uint32_t));
+      off += sizeof(uint32_t);
+      if (sz == XALT_PAYLOAD_NULL)
+        continue;
+      if (len - off < sz || (strA[i] = strndup(&buf[off], sz)) == NULL)
+        goto bad;
+      off += sz;
+    }
+  free(buf);
+  return 0;
+
+ bad:
+  free(buf);
+  for (i = 0; i < n; i++)
+    {
+      free(strA[i]);
+      strA[i] = NULL;
+    }
+  return -1;
+}
@@ -0,0 +1,46 @@
+#ifndef XALT_PAYLOAD_H
+#define XALT_PAYLOAD_H
+
+#include "xalt_obfuscate.h"
+
+/*
+ * The strings of a run record (exec path, watermark, json command line,
+ * PATH, LD_LIBRARY_PATH and the library list) are handed from
+ * libxalt_init.so to xalt_run_submission through an inherited file
+ * descriptor (--payload_fd) instead of being quoted and base64 encoded
+ * into argv.  The payload is
+ *
+ *     "XPL1" <uint32 n> n * (<uint32 len> <len bytes>)
+ *
+ * in host byte order, where len == XALT_PAYLOAD_NULL marks a missing
+ * string.  The strings are not NUL terminated in the payload.
+ */
+
+#define XALT_PAYLOAD_MAGIC  "XPL1"
+#define XALT_PAYLOAD_NULL   0xffffffffU
+#define XALT_PAYLOAD_MAX    (64U << 20)
+
+enum { XALT_PAYLOAD_EXEC = 0, XALT_PAYLOAD_WATERMARK, XALT_PAYLOAD_CMDLINE, XALT_PAYLOAD_PATH,
+       XALT_PAYLOAD_LDLIBPATH, XALT_PAYLOAD_LIBS, XALT_PAYLOAD_NSTR };
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Returns a descriptor (without FD_CLOEXEC) positioned at the start of
+ * the payload: a sealed memfd, or a pipe that already holds it.  The
+ * caller closes it once the child has been started.  Returns -1 when
+ * neither can be made. */
+int xalt_payload_create(const char* strA[], int n);
+
+/* Read a payload from fd and close fd.  strA[i] is a malloc'ed copy of
+ * string i, or NULL.  Returns 0, or -1 when fd does not hold a payload
+ * of n strings. */
+int xalt_payload_read(int fd, char* strA[], int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XALT_PAYLOAD_H */
@@ -0,0 +1,168 @@
+#define  _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "xalt_pkg.h"
+#include "xalt_quotestring.h"
+#include "xalt_tmpdir.h"
+
+#define XALT_PKG_FN "pkgs.jsonl"
+
+/*
+ * The packages already recorded by this process are kept as 64 bit
+ * hashes of (program, name, version, path) in an open addressing table
+ * (0 marks an empty slot).  A child made by fork() inherits the table
+ * and the file; packages recorded twice by different processes are
+ * removed when the run's packages are transmitted.
+ */
+
+static uint64_t*     tableG = NULL;
+static size_t        capG   = 0;
+static size_t        numG   = 0;
+static int           fdG    = -1;
+static volatile char lockG  = 0;
+
+// A child of fork() has only the forking thread: a lock held in the parent is stale.
+static void after_fork_in_child(void)
+{
+  lockG = 0;
+}
+
+__attribute__((constructor))
+static void register_fork_handler(void)
+{
+  pthread_atfork(NULL, NULL, after_fork_in_child);
+}
+
+static uint64_t hash_pkg(const char* strA[4])
+{
+  uint64_t h = 14695981039346656037ULL;
+  int      i;
+  for (i = 0; i < 4; i++)
+    {
+      const unsigned char* p = (const unsigned char *) strA[i];
+      for ( ; *p; p++)
+        h = (h ^ *p) * 1099511628211ULL;
+      h = (h ^ 0xff) * 1099511628211ULL;
+    }
+  return h ? h : 1;
+}
+
+/* Returns 1 when h is in the table. */
+static int seen(uint64_t h)
+{
+  size_t i;
+  if (capG == 0)
+    return 0;
+  for (i = h & (capG - 1); tableG[i]; i = (i + 1) & (capG - 1))
+    if (tableG[i] == h)
+      return 1;
+  return 0;
+}
+
+/* Add h, which is not in the table yet.  Returns -1 when the table
+ * cannot grow. */
+static int add(uint64_t h)
+{
+  size_t i;
+  if (2*(numG + 1) > capG)
+    {
+      size_t    oldCap = capG;
+      uint64_t* oldT   = tableG;
+      size_t    newCap = capG ? 2*capG : 512;
+      uint64_t* newT   = (uint64_t *) calloc(newCap, sizeof(uint64_t));
+      if (newT == NULL)
+        return -1;
+      tableG = newT;
+      capG   = newCap;
+      numG   = 0;
+      for (i = 0; i < oldCap; i++)
+        if (oldT[i])
+          add(oldT[i]);
+      free(oldT);
+    }
+  for (i = h & (capG - 1); tableG[i]; i = (i + 1) & (capG - 1))
+    ;
+  tableG[i] = h;
+  numG++;
+  return 0;
+}
+
+static int open_pkg_file(const char* run_uuid)
+{
+  char* dir = create_xalt_tmpdir_str(run_uuid);
+  char* fn  = NULL;
+  int   fd  = -1;
+  if (dir && (mkdir(dir, 0700) == 0 || errno == EEXIST) &&
+      asprintf(&fn, "%s" XALT_PKG_FN, dir) > 0)
+    fd = open(fn, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  free(dir);
+  free(fn);
+  return fd;
+}
+
+__attribute__((visibility("default")))
+int xalt_pkg_record(const char* program, const char* name, const char* version, const char* path)
+{
+  static const char* keyA[4] = { "{\"program\":\"", "\",\"package_name\":\"",
+                                 "\",\"package_version\":\"", "\",\"package_path\":\"" };
+  const char* strA[4]  = { program, name, version, path };
+  const char* run_uuid = getenv("XALT_RUN_UUID");
+  size_t      sz       = 4;
+  char*       line;
+  char*       s;
+  uint64_t    h;
+  int         i, result;
+
+  if (run_uuid == NULL || program == NULL || name == NULL)
+    return -1;
+  for (i = 0; i < 4; i++)
+    {
+      if (strA[i] == NULL)
+        strA[i] = "";
+      sz += strlen(keyA[i]) + XALT_QUOTESTRING_MAX(strlen(strA[i]));
+    }
+
+  while (__atomic_test_and_set(&lockG, __ATOMIC_ACQUIRE))
+    ;
+
+  // A package goes in the table only once it is in the file, so a
+  // failed write is tried again the next time it is recorded.
+  h      = hash_pkg(strA);
+  result = 1;
+  if (! seen(h))
+    {
+      result = -1;
+      if (fdG < 0)
+        fdG = open_pkg_file(run_uuid);
+      if (fdG >= 0 && (line = (char *) malloc(sz)) != NULL)
+        {
+          // One write() per package so that the lines of processes sharing the run do not mix.
+          s = line;
+          for (i = 0; i < 4; i++)
+            {
+              size_t len = strlen(keyA[i]);
+              memcpy(s, keyA[i], len);
+              s = xalt_quotestring_to(s + len, strA[i], strlen(strA[i]));
+            }
+          memcpy(s, "\"}\n", 3);
+          s += 3;
+          if (write(fdG, line, s - line) == s - line)
+            {
+              result = 0;
+              add(h);
+            }
+          free(line);
+        }
+    }
+
+  __atomic_clear(&lockG, __ATOMIC_RELEASE);
+  return result;
+}
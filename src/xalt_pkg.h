@@ -0,0 +1,28 @@
+#ifndef XALT_PKG_H
+#define XALT_PKG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * libxalt_pkg.so: record the packages that a Python, R or MATLAB run
+ * uses from inside the interpreter (through ctypes, .Call, ...) instead
+ * of running xalt_record_pkg once per package.  Each package is kept
+ * once per process and written as one line to the package file of the
+ * run in XALT_TMPDIR/XALT_pkg_<run_uuid>/.  At the end of the run all
+ * the packages are transmitted as one record.
+ *
+ * Returns 0 when the package was recorded, 1 when it had been recorded
+ * already and -1 when this run is not tracked by XALT (or the package
+ * could not be written).
+ */
+
+int xalt_pkg_record(const char* program, const char* name, const char* version, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_PKG_H
@@ -13,77 +13,223 @@ static const char *qcharA[] = { "\\u0000","\\u0001","\\u0002","\\u0003","\\u0004
                                 "\\u0018","\\u0019","\\u001a","\\u001b","\\u001c","\\u001d","\\u001e","\\u001f",
                                 " "      ,      "!",   "\\\""};
 
+static const unsigned char qlenA[] = { 6, 6, 6, 6, 6, 6, 6, 6,
+                                      2, 2, 2, 6, 2, 2, 6, 6,
+                                      6, 6, 2, 6, 6, 6, 6, 6,
+                                      6, 6, 6, 6, 6, 6, 6, 6,
+                                      1, 1, 2 };
+
 static const char escCharA[] = {'a', '\b', 'c','d','e','\f','g','h','i','j','k','l','m','\n','o','p','q','\r','s',
                                 '\t'};
 
 static char*        buff = NULL;
 static unsigned int sz   = 0;
 
+/*
+ * Finding the characters that need quoting.  Environment values and
+ * command lines are mostly plain ASCII, so the clean runs between them
+ * are found 16 (SSE2) or 32 (AVX2) bytes at a time when the CPU has
+ * them.  A byte needs quoting when it is a control character, '"', '\\'
+ * or >= 0x7f.  With signed bytes "< 0x20" also catches everything
+ * >= 0x80.
+ */
 
-const char* xalt_quotestring(const char* input)
+static size_t plain_len_scalar(const unsigned char* p, size_t len)
 {
-  const char    *p = input;
-  char          *s;
-  unsigned char a,b,c,d;
-  unsigned int  currSz;
-  int           high, low, len;
-
-  len    = strlen(input);
-  currSz = 3*len+1;
-  if (sz < currSz)
+  size_t i;
+  for (i = 0; i < len; ++i)
     {
-      sz = currSz;
-      if (buff)
-        free(buff);
-      buff = (char *) malloc(sz);
+      unsigned char c = p[i];
+      if (c < 0x020 || c == '"' || c == '\\' || c >= 0x07f)
+        break;
     }
-  s = buff;
+  return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+
+__attribute__((target("sse2"), always_inline))
+static inline unsigned int mask16(const unsigned char* p)
+{
+  const __m128i sp  = _mm_set1_epi8(0x20);
+  const __m128i dq  = _mm_set1_epi8('"');
+  const __m128i bs  = _mm_set1_epi8('\\');
+  const __m128i del = _mm_set1_epi8(0x7f);
+  __m128i       v   = _mm_loadu_si128((const __m128i *) p);
+  __m128i       m   = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, sp), _mm_cmpeq_epi8(v, dq)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, bs), _mm_cmpeq_epi8(v, del)));
+  return (unsigned int) _mm_movemask_epi8(m);
+}
+
+/* The last partial block is checked by loading the last 16 bytes again
+ * and dropping the lanes that have already been checked. */
+__attribute__((target("sse2"), always_inline))
+static inline size_t plain_len_16(const unsigned char* p, size_t len)
+{
+  size_t       i;
+  unsigned int m;
+  if (len < 16)
+    return plain_len_scalar(p, len);
+  for (i = 0; i + 16 <= len; i += 16)
+    if ((m = mask16(p + i)) != 0)
+      return i + __builtin_ctz(m);
+  if (i < len && (m = mask16(p + len - 16) >> (16 - (len - i))) != 0)
+    return i + __builtin_ctz(m);
+  return len;
+}
+
+__attribute__((target("sse2")))
+static size_t plain_len_sse2(const unsigned char* p, size_t len)
+{
+  return plain_len_16(p, len);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline unsigned int mask32(const unsigned char* p)
+{
+  const __m256i sp  = _mm256_set1_epi8(0x20);
+  const __m256i dq  = _mm256_set1_epi8('"');
+  const __m256i bs  = _mm256_set1_epi8('\\');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  __m256i       v   = _mm256_loadu_si256((const __m256i *) p);
+  __m256i       m   = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi8(sp, v), _mm256_cmpeq_epi8(v, dq)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, bs), _mm256_cmpeq_epi8(v, del)));
+  return (unsigned int) _mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static size_t plain_len_avx2(const unsigned char* p, size_t len)
+{
+  size_t       i;
+  unsigned int m;
+  if (len < 32)
+    return plain_len_16(p, len);
+  for (i = 0; i + 32 <= len; i += 32)
+    if ((m = mask32(p + i)) != 0)
+      return i + __builtin_ctz(m);
+  if (i < len && (m = mask32(p + len - 32) >> (32 - (len - i))) != 0)
+    return i + __builtin_ctz(m);
+  return len;
+}
+#endif
+
+static size_t (*plain_lenP)(const unsigned char* p, size_t len) = NULL;
+
+static size_t plain_len(const unsigned char* p, size_t len)
+{
+  if (plain_lenP == NULL)
+    {
+      plain_lenP = plain_len_scalar;
+#ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+        plain_lenP = plain_len_avx2;
+      else if (__builtin_cpu_supports("sse2"))
+        plain_lenP = plain_len_sse2;
+#endif
+    }
+  return (*plain_lenP)(p, len);
+}
+
+size_t xalt_quotestring_plain_len(const char* input, size_t len)
+{
+  return plain_len((const unsigned char *) input, len);
+}
+
+/* Write \\uXXXX (lower case hex, as "\\u%.4x" does) for value <= 0xffff. */
+static char* put_u(char* s, int value)
+{
+  static const char hexA[] = "0123456789abcdef";
+  s[0] = '\\';
+  s[1] = 'u';
+  s[2] = hexA[(value >> 12) & 0xf];
+  s[3] = hexA[(value >>  8) & 0xf];
+  s[4] = hexA[(value >>  4) & 0xf];
+  s[5] = hexA[ value        & 0xf];
+  return s + 6;
+}
 
-  for (; *p; ++p)
+
+/*
+ * Write the JSON quoted version of input[0..len) to out and return a
+ * pointer to the terminating '\0'.  out must have room for
+ * XALT_QUOTESTRING_MAX(len) bytes: a control character becomes six.
+ */
+char* xalt_quotestring_to(char* out, const char* input, size_t len)
+{
+  const unsigned char *p   = (const unsigned char *) input;
+  const unsigned char *end = p + len;
+  char                *s   = out;
+  unsigned char        a,b,c,d;
+  int                  high, low;
+
+  while (p < end)
     {
+      /* Copy the run of characters that need no quoting in one go. */
+      size_t n = plain_len(p, end - p);
+      if (n > 0)
+        {
+          memcpy(s, p, n);
+          s += n;
+          p += n;
+          if (p >= end)
+            break;
+        }
+
       a = *p;
       if (a < 0x023)
         {
-          const char *r = qcharA[a];
-          len = strlen(r);
-          memcpy(s,r,len);
-          s += len;
+          memcpy(s,qcharA[a],qlenA[a]);
+          s += qlenA[a];
         }
       else if (a == '\\')
         {
           memcpy(s,"\\\\",2);
           s += 2;
         }
-      else if (a < 0x07f)
-        *s++ = a;
       else
         {
           int value;
-          b = *++p;
+          b = (p + 1 < end) ? *++p : 0;
           if (0xc0 <= a &&  a <= 0xdf &&  b >= 0x80)
             value = (a - 0xc0) * 0x40 + b - 0x80;
-          else if ( 0xe0 <= a &&  a <= 0xef &&  b >= 0x80 &&  (c = *++p) >= 0x80)
+          else if ( 0xe0 <= a &&  a <= 0xef &&  b >= 0x80 && p + 1 < end && (c = *++p) >= 0x80)
             value = ((a - 0xe0) * 0x40 + b - 0x80) * 0x40 + c - 0x80;
-          else if (  0xf0 <= a &&  a <= 0xf7 &&  b >= 0x80 && (c = *++p) >= 0x80 && (d = *++p) >= 0x80 )
+          else if (  0xf0 <= a &&  a <= 0xf7 &&  b >= 0x80 && p + 2 < end && (c = *++p) >= 0x80 && (d = *++p) >= 0x80 )
             value = (((a - 0xf0) * 0x40 + b - 0x80) * 0x40 + c - 0x80) * 0x40 + d - 0x80;
           else
             value = 0;
           if (value <= 0xffff)
-            {
-              sprintf(s,"\\u%.4x",value);
-              s += 6;
-            }
+            s = put_u(s, value);
           else if (value <= 0x10ffff)
             {
               value -= 0x10000;
               high   = 0xD800 + (value/0x400);
               low    = 0xDC00 + (value % 0x400);
-              sprintf(s,"\\u%.4x\\u%.4x",high,low);
-              s += 12;
+              s      = put_u(s, high);
+              s      = put_u(s, low);
             }
         }
+      ++p;
     }
   *s = '\0';
+  return s;
+}
+
+const char* xalt_quotestring(const char* input)
+{
+  size_t       len    = strlen(input);
+  unsigned int currSz = XALT_QUOTESTRING_MAX(len);
+  if (sz < currSz)
+    {
+      sz = currSz;
+      if (buff)
+        free(buff);
+      buff = (char *) malloc(sz);
+    }
+  xalt_quotestring_to(buff, input, len);
   return buff;
 }
 
@@ -1,13 +1,19 @@
 #ifndef QUOTESTRING_H
 #define QUOTESTRING_H
 
+#include <stddef.h>
 #include "xalt_obfuscate.h"
 
+/* Largest size of the quoted version of a string of n bytes (+ '\0'). */
+#define XALT_QUOTESTRING_MAX(n) (6*(n)+1)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
   const char* xalt_quotestring(  const char* input);
+  char*       xalt_quotestring_to(char* out, const char* input, size_t len);
+  size_t      xalt_quotestring_plain_len(const char* input, size_t len);
   const char* xalt_unquotestring(const char* input, int len);
   void        xalt_quotestring_free();
 
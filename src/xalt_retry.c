@@ -0,0 +1,288 @@
+#define  _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "xalt_retry.h"
+#include "transmit.h"
+#include "xalt_config.h"
+#include "xalt_c_utils.h"
+
+#define XALT_RETRY_MAX_SIZE (16UL << 20)
+#define XALT_RETRY_FIRST    30         /* s before the first retry */
+#define XALT_RETRY_LONGEST  3600       /* s between retries at most */
+#define XALT_RETRY_STALE    600        /* s a replay may hold a record */
+#define XALT_RETRY_MAGIC    "XALTRQ1"
+#define XALT_RETRY_FIELDS   8
+
+/*
+ * A parked record is the file
+ *
+ *     <next try: epoch, 10 digits>.<tries>.<id>.rq
+ *
+ * so that the names sort in the order the records are due.  The file
+ * holds the line XALTRQ1, the transmission, kind, key, syshost,
+ * resultDir, resultFn, is_binary and the length of the record, one per
+ * line, and then the record.  A record being replayed is renamed to
+ * *.rq.busy so that two replays cannot both take it.
+ */
+
+static int enabled()
+{
+  const char* v = getenv("XALT_RETRY_QUEUE");
+  return v == NULL || strcasecmp(v, "no") != 0;
+}
+
+static size_t max_size()
+{
+  const char* v = getenv("XALT_RETRY_MAX_SIZE");
+  size_t      sz;
+  if (v == NULL || (sz = strtoull(v, NULL, 10)) == 0)
+    sz = XALT_RETRY_MAX_SIZE;
+  return sz;
+}
+
+static char* queue_dir()
+{
+  char* dir = NULL;
+  asprintf(&dir, "%s/XALT_retry_%d/", XALT_TMPDIR, (int) getuid());
+  return dir;
+}
+
+static int ends_with(const char* s, const char* tail)
+{
+  size_t n = strlen(s), m = strlen(tail);
+  return n > m && strcmp(&s[n-m], tail) == 0;
+}
+
+/* The bytes parked in dir. */
+static size_t queue_size(const char* dir)
+{
+  DIR*           dirp = opendir(dir);
+  struct dirent* dp;
+  struct stat    st;
+  size_t         sz   = 0;
+  if (dirp == NULL)
+    return 0;
+  while ((dp = readdir(dirp)) != NULL)
+    if (dp->d_name[0] != '.' && fstatat(dirfd(dirp), dp->d_name, &st, 0) == 0)
+      sz += st.st_size;
+  closedir(dirp);
+  return sz;
+}
+
+int xalt_retry_park(const char* transmission, const char* rec, size_t len, int is_binary,
+                    const char* kind, const char* key, const char* syshost, const char* resultDir,
+                    const char* resultFn)
+{
+  struct timeval tv;
+  char*          dir   = NULL;
+  char*          hdr   = NULL;
+  char*          tmpFn = NULL;
+  char*          fn    = NULL;
+  int            hlen, i;
+  int            fd    = -1;
+  int            err   = -1;
+
+  if (! enabled() || (dir = queue_dir()) == NULL)
+    return -1;
+
+  hlen = asprintf(&hdr, XALT_RETRY_MAGIC "\n%s\n%s\n%s\n%s\n%s\n%s\n%d\n%zu\n", transmission, kind,
+                  key ? key : "", syshost ? syshost : "", resultDir ? resultDir : "",
+                  resultFn ? resultFn : "", is_binary, len);
+  if (hlen < 0 || queue_size(dir) + hlen + len > max_size())
+    goto done;
+
+  gettimeofday(&tv, NULL);
+  asprintf(&tmpFn, "%s.%ld%06ld_%d.tmp", dir, (long) tv.tv_sec, (long) tv.tv_usec, (int) getpid());
+  asprintf(&fn, "%s%010ld.01.%ld%06ld_%d.rq", dir, (long) tv.tv_sec + XALT_RETRY_FIRST,
+           (long) tv.tv_sec, (long) tv.tv_usec, (int) getpid());
+
+  // A flush may remove the empty queue directory between mkpath() and open().
+  for (i = 0; i < 2; i++)
+    {
+      if (mkpath(dir, 0700) != 0)
+        goto done;
+      if ((fd = open(tmpFn, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) >= 0 || errno != ENOENT)
+        break;
+    }
+  if (fd < 0)
+    goto done;
+  err = write_all(fd, hdr, hlen) || write_all(fd, rec, len);
+  close(fd);
+  if (err == 0)
+    err = rename(tmpFn, fn);
+  if (err)
+    unlink(tmpFn);
+
+ done:
+  free(dir);
+  free(hdr);
+  free(tmpFn);
+  free(fn);
+  return err ? -1 : 0;
+}
+
+/* Read a parked record and transmit it once. */
+static int replay(const char* fn)
+{
+  struct stat st;
+  char*       buf;
+  char*       fieldA[XALT_RETRY_FIELDS+1];
+  char*       p;
+  int         fd, i;
+  int         err = 1;
+
+  if ((fd = open(fn, O_RDONLY | O_CLOEXEC)) < 0)
+    return 1;
+  if (fstat(fd, &st) != 0 || (buf = (char *) malloc(st.st_size + 1)) == NULL)
+    {
+      close(fd);
+      return 1;
+    }
+  if (read(fd, buf, st.st_size) != st.st_size)
+    st.st_size = 0;
+  close(fd);
+  buf[st.st_size] = '\0';
+
+  // A damaged record is dropped (err stays 1).
+  p = buf;
+  for (i = 0; i <= XALT_RETRY_FIELDS; i++)
+    {
+      char* nl = memchr(p, '\n', &buf[st.st_size] - p);
+      if (nl == NULL)
+        break;
+      *nl       = '\0';
+      fieldA[i] = p;
+      p         = nl + 1;
+    }
+  if (i > XALT_RETRY_FIELDS && strcmp(fieldA[0], XALT_RETRY_MAGIC) == 0)
+    {
+      size_t len = strtoull(fieldA[8], NULL, 10);
+      if (len == (size_t) (&buf[st.st_size] - p))
+        err = transmit_record_once(fieldA[1], p, len, atoi(fieldA[7]), fieldA[2], fieldA[3],
+                                   fieldA[4], fieldA[5][0] ? fieldA[5] : NULL,
+                                   fieldA[6][0] ? fieldA[6] : NULL);
+    }
+  free(buf);
+  return err;
+}
+
+static int cmp_names(const void* a, const void* b)
+{
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+int xalt_retry_flush(int batch, int force, int* left)
+{
+  DIR*           dirp;
+  struct dirent* dp;
+  struct stat    st;
+  char*          dir;
+  char**         nameA = NULL;
+  int            n     = 0;
+  int            cap   = 0;
+  int            sent  = 0;
+  int            done  = 0;
+  int            gone  = 0;
+  int            i;
+  time_t         now   = time(NULL);
+
+  if (left)
+    *left = 0;
+  if (! enabled() || (dir = queue_dir()) == NULL)
+    return 0;
+  if ((dirp = opendir(dir)) == NULL)
+    {
+      free(dir);
+      return 0;
+    }
+
+  while ((dp = readdir(dirp)) != NULL)
+    {
+      const char* name = dp->d_name;
+      if (ends_with(name, ".rq"))
+        {
+          if (n == cap)
+            {
+              cap   = cap ? 2*cap : 64;
+              nameA = (char **) realloc(nameA, cap*sizeof(char *));
+            }
+          nameA[n++] = strdup(name);
+        }
+      else if ((ends_with(name, ".rq.busy") || ends_with(name, ".tmp")) &&
+               fstatat(dirfd(dirp), name, &st, 0) == 0 && now - st.st_mtime > XALT_RETRY_STALE)
+        {
+          // Left behind by a replay or a park that was killed.
+          char* back = strndup(name, strlen(name) - 5);
+          if (ends_with(name, ".tmp"))
+            unlinkat(dirfd(dirp), name, 0);
+          else
+            renameat(dirfd(dirp), name, dirfd(dirp), back);
+          free(back);
+        }
+    }
+
+  if (n > 1)
+    qsort(nameA, n, sizeof(char *), cmp_names);
+
+  for (i = 0; i < n; i++)
+    {
+      char  id[64];
+      long  next;
+      int   tries;
+      char* fn     = NULL;
+      char* busyFn = NULL;
+
+      if (sscanf(nameA[i], "%ld.%d.%63[^.].rq", &next, &tries, id) != 3)
+        continue;
+      if ((! force && next > now) || (batch > 0 && done >= batch))
+        break;
+
+      asprintf(&fn,     "%s%s",      dir, nameA[i]);
+      asprintf(&busyFn, "%s%s.busy", dir, nameA[i]);
+      if (rename(fn, busyFn) == 0)
+        {
+          int err = replay(busyFn);
+          done++;
+          if (err == 0)
+            sent++;
+          if (err >= 0 || tries >= XALT_RETRY_MAX_TRIES)
+            {
+              unlink(busyFn);
+              gone++;
+            }
+          else
+            {
+              long  delay = XALT_RETRY_FIRST << (tries < 7 ? tries : 7);
+              char* newFn = NULL;
+              if (delay > XALT_RETRY_LONGEST)
+                delay = XALT_RETRY_LONGEST;
+              asprintf(&newFn, "%s%010ld.%02d.%s.rq", dir, (long) now + delay, tries + 1, id);
+              rename(busyFn, newFn);
+              free(newFn);
+            }
+        }
+      free(fn);
+      free(busyFn);
+    }
+
+  closedir(dirp);
+  if (left)
+    *left = n - gone;
+  if (n == gone)
+    rmdir(dir);
+  for (i = 0; i < n; i++)
+    free(nameA[i]);
+  free(nameA);
+  free(dir);
+  return sent;
+}
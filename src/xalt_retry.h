@@ -0,0 +1,41 @@
+#ifndef XALT_RETRY_H
+#define XALT_RETRY_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Records that transmit_record() could not write, spool or send are
+ * parked, one file each, in the node local retry queue
+ * XALT_TMPDIR/XALT_retry_<uid>/ instead of being lost.  After the next
+ * record that goes through, up to XALT_RETRY_BATCH parked records whose
+ * time has come are replayed; xalt_retry_flush(0, 1, NULL) replays them
+ * all.  A record that fails again waits twice as long as the time
+ * before (30 seconds at first, an hour at most) and is dropped after
+ * XALT_RETRY_MAX_TRIES tries.  A user's queue is capped at
+ * XALT_RETRY_MAX_SIZE bytes (16 MiB by default).  XALT_RETRY_QUEUE=no
+ * turns the queue off.
+ */
+
+#define XALT_RETRY_BATCH     16
+#define XALT_RETRY_MAX_TRIES 24
+
+/* Park a record.  Returns 0 when it was parked. */
+int xalt_retry_park(const char* transmission, const char* rec, size_t len, int is_binary,
+                    const char* kind, const char* key, const char* syshost, const char* resultDir,
+                    const char* resultFn);
+
+/* Replay up to batch parked records (all of them if batch <= 0) that
+ * are due, or regardless of their back-off with force.  Returns the
+ * number that went through and sets *left (if not NULL) to the number
+ * still parked. */
+int xalt_retry_flush(int batch, int force, int* left);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_RETRY_H
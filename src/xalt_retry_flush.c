@@ -0,0 +1,31 @@
+// xalt_retry_flush: replay the records that are parked in this user's
+// retry queue on this node (see xalt_retry.h), for example from a job
+// epilog.
+//
+//    xalt_retry_flush [--due]
+//
+// All the parked records are tried, whatever their back-off, unless
+// --due is given.
+
+#include <stdio.h>
+#include <string.h>
+#include "xalt_retry.h"
+
+int main(int argc, char* argv[])
+{
+  int force = 1;
+  int left;
+  int sent;
+
+  if (argc > 2 || (argc == 2 && strcmp(argv[1], "--due") != 0))
+    {
+      fprintf(stderr, "Usage: %s [--due]\n", argv[0]);
+      return 1;
+    }
+  if (argc == 2)
+    force = 0;
+
+  sent = xalt_retry_flush(0, force, &left);
+  printf("replayed: %d, still parked: %d\n", sent, left);
+  return left > 0;
+}
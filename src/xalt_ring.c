@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "xalt_ring.h"
+
+/*
+ * A bounded multi-producer single-consumer ring (after D. Vyukov's
+ * bounded queue).  Slot i starts with seq == i.  A producer owns ticket
+ * pos once it has advanced head from pos to pos+1 while the slot's seq
+ * was pos.  It copies the record in and publishes it by setting
+ * seq = pos+1.  The consumer takes a published slot by moving seq from
+ * pos+1 to pos+3 and hands it back by setting seq = pos+nslots, which
+ * also tells a producer waiting on that slot that the collector has
+ * what it needs.  A producer that gives up on the collector (it timed
+ * out or the collector is going away) withdraws its record by moving
+ * seq from pos+1 to pos+2 and falls back to xalt_run_submission; the
+ * consumer skips a withdrawn slot.  Only one of the two moves from
+ * pos+1 can succeed, so a record is never written twice or lost.
+ *
+ * A producer that dies between claiming a ticket and publishing it
+ * stalls the ring: everyone else then finds it full and falls back to
+ * running xalt_run_submission.  Restarting xalt_collectord builds a new
+ * ring.
+ */
+
+#define HDR_SZ 64
+
+#ifdef __linux__
+_Static_assert(sizeof(xalt_ring_rec_t) == 136, "xalt_ring_rec_t must be the same for 32 and 64 bit");
+_Static_assert(sizeof(xalt_ring_hdr_t) <= HDR_SZ, "xalt_ring_hdr_t is too big");
+
+static void futex_wait(volatile uint32_t* addr, uint32_t val, double timeout)
+{
+  struct timespec ts;
+  ts.tv_sec  = (time_t) timeout;
+  ts.tv_nsec = (long) ((timeout - (double) ts.tv_sec)*1.0e9);
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void futex_wake(volatile uint32_t* addr, int n)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+static double wall_time()
+{
+  struct timeval tm;
+  gettimeofday(&tm, 0);
+  return tm.tv_sec + 1.0e-6*tm.tv_usec;
+}
+
+static xalt_ring_slot_t* ring_slot(xalt_ring_t* ring, uint32_t pos)
+{
+  return (xalt_ring_slot_t *) (ring->slots + (size_t) (pos & (ring->hdr->nslots - 1))*ring->hdr->slot_sz);
+}
+
+/* The states of the slot of ticket pos beyond those of a plain ring. */
+#define SEQ_PUBLISHED(pos) ((pos) + 1)
+#define SEQ_WITHDRAWN(pos) ((pos) + 2)
+#define SEQ_TAKEN(pos)     ((pos) + 3)
+
+static int collector_alive(xalt_ring_hdr_t* hdr)
+{
+  uint32_t beat = __atomic_load_n(&hdr->heartbeat, __ATOMIC_ACQUIRE);
+  pid_t    pid  = __atomic_load_n(&hdr->daemon_pid, __ATOMIC_ACQUIRE);
+
+  if (pid <= 0 || (uint32_t) time(NULL) - beat > XALT_RING_STALE)
+    return 0;
+  return (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/* Use /dev/shm directly (that is all shm_open() does on Linux) so that
+ * neither libxalt_init.so nor the user's link needs -lrt. */
+static int shm_fd(const char* name, int flags, mode_t mode)
+{
+  char* fn = NULL;
+  asprintf(&fn, "/dev/shm/%s", (name[0] == '/') ? name + 1 : name);
+  int fd = open(fn, flags | O_NOFOLLOW, mode);
+  free(fn);
+  return fd;
+}
+
+static void shm_remove(const char* name)
+{
+  char* fn = NULL;
+  asprintf(&fn, "/dev/shm/%s", (name[0] == '/') ? name + 1 : name);
+  unlink(fn);
+  free(fn);
+}
+
+static xalt_ring_t* ring_map(int fd, size_t map_sz)
+{
+  void* p = mmap(NULL, map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+
+  xalt_ring_t* ring = (xalt_ring_t *) malloc(sizeof(xalt_ring_t));
+  ring->hdr    = (xalt_ring_hdr_t *) p;
+  ring->slots  = (char *) p + HDR_SZ;
+  ring->map_sz = map_sz;
+  return ring;
+}
+#endif
+
+/* The ring is per user: xalt_collectord runs as the user so that it can
+ * read /proc/$pid of the user's programs and write their records. */
+char* xalt_ring_name()
+{
+  char*       name = NULL;
+  const char* v    = getenv("XALT_COLLECTOR_RING");
+  if (v)
+    return strdup(v);
+  asprintf(&name, "/xalt_ring_%u", (unsigned int) getuid());
+  return name;
+}
+
+/* Returns NULL when there is no ring or no live collector behind it. */
+xalt_ring_t* xalt_ring_attach(const char* name)
+{
+#ifdef __linux__
+  struct stat st;
+  int fd = shm_fd(name, O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0)
+    return NULL;
+
+  /* Never hand our command line to a ring that someone else created */
+  if (fstat(fd, &st) != 0 || st.st_uid != getuid() || st.st_size < HDR_SZ)
+    {
+      close(fd);
+      return NULL;
+    }
+
+  xalt_ring_t* ring = ring_map(fd, (size_t) st.st_size);
+  close(fd);
+  if (ring == NULL)
+    return NULL;
+
+  xalt_ring_hdr_t* hdr = ring->hdr;
+  uint64_t magic = hdr->magic;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (magic != XALT_RING_MAGIC ||
+      HDR_SZ + (size_t) hdr->nslots*hdr->slot_sz > ring->map_sz ||
+      ! collector_alive(hdr))
+    {
+      xalt_ring_detach(ring);
+      return NULL;
+    }
+  return ring;
+#else
+  return NULL;
+#endif
+}
+
+void xalt_ring_detach(xalt_ring_t* ring)
+{
+  if (ring == NULL)
+    return;
+  munmap(ring->hdr, ring->map_sz);
+  free(ring);
+}
+
+/* Take the record back unless the collector already has it.  Returns 1
+ * when it was withdrawn and 0 when the collector has it. */
+static int withdraw(xalt_ring_slot_t* slot, uint32_t pos)
+{
+  uint32_t seq = SEQ_PUBLISHED(pos);
+  return __atomic_compare_exchange_n(&slot->seq, &seq, SEQ_WITHDRAWN(pos), 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? 1 : 0;
+}
+
+/*
+ * Copy rec and its strings into the ring.  The length of strA[i] is
+ * lenIn[i], or strlen(strA[i]) when lenIn is NULL.  If wait_time > 0 then wait
+ * (at most wait_time seconds) until the collector has taken the record,
+ * i.e. it has read everything it needs from /proc/$pid.  Returns 0 when
+ * the collector has the record, -1 if the record does not fit or the
+ * ring is full and 1 if the record was withdrawn because the collector
+ * did not take it in time or is shutting down.  For anything but 0 the
+ * caller has to send the record itself.
+ */
+int xalt_ring_push(xalt_ring_t* ring, const xalt_ring_rec_t* rec, const char* strA[],
+                   const uint32_t lenIn[], double wait_time)
+{
+#ifdef __linux__
+  int              i;
+  uint32_t         lenA[XALT_RING_NSTR];
+  size_t           total = offsetof(xalt_ring_slot_t, rec) + sizeof(xalt_ring_rec_t);
+  xalt_ring_hdr_t* hdr   = ring->hdr;
+
+  for (i = 0; i < XALT_RING_NSTR; ++i)
+    {
+      lenA[i] = ! strA[i] ? 0 : (lenIn ? lenIn[i] : (uint32_t) strlen(strA[i]));
+      total  += lenA[i] + 1;
+    }
+  if (total > hdr->slot_sz)
+    return -1;
+
+  xalt_ring_slot_t* slot;
+  uint32_t          pos = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+  while (1)
+    {
+      slot         = ring_slot(ring, pos);
+      uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      int32_t  dif = (int32_t) (seq - pos);
+      if (dif == 0)
+        {
+          if (__atomic_compare_exchange_n(&hdr->head, &pos, pos + 1, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+        }
+      else if (dif < 0)
+        return -1;
+      else
+        pos = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+    }
+
+  memcpy(&slot->rec, rec, sizeof(xalt_ring_rec_t));
+  char* p = (char *) (&slot->rec + 1);
+  for (i = 0; i < XALT_RING_NSTR; ++i)
+    {
+      slot->rec.lenA[i] = lenA[i];
+      if (lenA[i])
+        memcpy(p, strA[i], lenA[i]);
+      p[lenA[i]] = '\0';
+      p         += lenA[i] + 1;
+    }
+  slot->len = (uint32_t) total;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+  __atomic_fetch_add(&hdr->wake, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&hdr->sleeping, __ATOMIC_SEQ_CST))
+    futex_wake(&hdr->wake, 1);
+
+  /* The collector may have started to shut down after we attached: its
+   * last drain might not see this record. */
+  if (! collector_alive(hdr))
+    return withdraw(slot, pos);
+
+  if (wait_time > 0.0)
+    {
+      double   t_end = wall_time() + wait_time;
+      uint32_t seq;
+      while ((seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)) == SEQ_PUBLISHED(pos) ||
+             seq == SEQ_TAKEN(pos))
+        {
+          double remain = t_end - wall_time();
+          if (remain <= 0.0)
+            return withdraw(slot, pos);
+          futex_wait(&slot->seq, seq, remain);
+        }
+    }
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/*
+ * Create the ring.  Fails if another collector is already serving it.
+ * A ring left behind by a collector that is gone is replaced.
+ */
+xalt_ring_t* xalt_ring_create(const char* name, uint32_t nslots, uint32_t slot_sz)
+{
+#ifdef __linux__
+  uint32_t i;
+
+  /* nslots must be a power of two, and at least 4 so that the slot
+   * states above do not overlap. */
+  if (nslots < 4 || (nslots & (nslots - 1)) != 0 || slot_sz < 1024)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+  slot_sz = (slot_sz + 63) & ~63U;
+
+  xalt_ring_t* old = xalt_ring_attach(name);
+  if (old)
+    {
+      xalt_ring_detach(old);
+      errno = EEXIST;
+      return NULL;
+    }
+  shm_remove(name);
+
+  int fd = shm_fd(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return NULL;
+
+  size_t map_sz = HDR_SZ + (size_t) nslots*slot_sz;
+  if (ftruncate(fd, (off_t) map_sz) != 0)
+    {
+      close(fd);
+      shm_remove(name);
+      return NULL;
+    }
+
+  xalt_ring_t* ring = ring_map(fd, map_sz);
+  close(fd);
+  if (ring == NULL)
+    {
+      shm_remove(name);
+      return NULL;
+    }
+
+  xalt_ring_hdr_t* hdr = ring->hdr;
+  hdr->nslots     = nslots;
+  hdr->slot_sz    = slot_sz;
+  hdr->head       = 0;
+  hdr->tail       = 0;
+  hdr->sleeping   = 0;
+  hdr->wake       = 0;
+  hdr->daemon_pid = getpid();
+  hdr->heartbeat  = (uint32_t) time(NULL);
+  for (i = 0; i < nslots; ++i)
+    ring_slot(ring, i)->seq = i;
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  hdr->magic = XALT_RING_MAGIC;
+  return ring;
+#else
+  errno = ENOSYS;
+  return NULL;
+#endif
+}
+
+#ifdef __linux__
+/* 1 when the slot at tail is published or withdrawn. */
+static int ring_ready(xalt_ring_t* ring)
+{
+  uint32_t pos = ring->hdr->tail;
+  uint32_t seq = __atomic_load_n(&ring_slot(ring, pos)->seq, __ATOMIC_ACQUIRE);
+  return seq == SEQ_PUBLISHED(pos) || seq == SEQ_WITHDRAWN(pos);
+}
+#endif
+
+/* Take the next published record, skipping withdrawn ones.  Returns
+ * NULL if there is none. */
+xalt_ring_slot_t* xalt_ring_peek(xalt_ring_t* ring)
+{
+#ifdef __linux__
+  while (1)
+    {
+      uint32_t          pos  = ring->hdr->tail;
+      xalt_ring_slot_t* slot = ring_slot(ring, pos);
+      uint32_t          seq  = SEQ_PUBLISHED(pos);
+      if (__atomic_compare_exchange_n(&slot->seq, &seq, SEQ_TAKEN(pos), 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return slot;
+      if (seq != SEQ_WITHDRAWN(pos))
+        break;
+      xalt_ring_release(ring);
+    }
+#endif
+  return NULL;
+}
+
+/* 1 when no producer holds a ticket that the collector has not handed
+ * back yet. */
+int xalt_ring_empty(xalt_ring_t* ring)
+{
+#ifdef __linux__
+  return __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE) == ring->hdr->tail;
+#else
+  return 1;
+#endif
+}
+
+/* Hand the slot returned by xalt_ring_peek() back to the producers. */
+void xalt_ring_release(xalt_ring_t* ring)
+{
+#ifdef __linux__
+  xalt_ring_hdr_t*  hdr  = ring->hdr;
+  uint32_t          pos  = hdr->tail;
+  xalt_ring_slot_t* slot = ring_slot(ring, pos);
+
+  __atomic_store_n(&slot->seq, pos + hdr->nslots, __ATOMIC_RELEASE);
+  __atomic_store_n(&hdr->tail, pos + 1, __ATOMIC_RELEASE);
+  futex_wake(&slot->seq, INT_MAX);
+#endif
+}
+
+/* Wait at most timeout seconds for a record.  Returns 1 if one is ready. */
+int xalt_ring_wait(xalt_ring_t* ring, double timeout)
+{
+#ifdef __linux__
+  xalt_ring_hdr_t* hdr = ring->hdr;
+
+  __atomic_store_n(&hdr->heartbeat, (uint32_t) time(NULL), __ATOMIC_RELEASE);
+  if (ring_ready(ring))
+    return 1;
+
+  uint32_t w = __atomic_load_n(&hdr->wake, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&hdr->sleeping, 1, __ATOMIC_SEQ_CST);
+  if (! ring_ready(ring))
+    futex_wait(&hdr->wake, w, timeout);
+  __atomic_store_n(&hdr->sleeping, 0, __ATOMIC_SEQ_CST);
+
+  __atomic_store_n(&hdr->heartbeat, (uint32_t) time(NULL), __ATOMIC_RELEASE);
+  return ring_ready(ring);
+#else
+  return 0;
+#endif
+}
+
+void xalt_ring_destroy(xalt_ring_t* ring, const char* name)
+{
+  if (ring == NULL)
+    return;
+#ifdef __linux__
+  __atomic_store_n(&ring->hdr->daemon_pid, 0, __ATOMIC_RELEASE);
+#endif
+  xalt_ring_detach(ring);
+#ifdef __linux__
+  shm_remove(name);
+#endif
+}
+
+const char* xalt_ring_rec_str(const xalt_ring_rec_t* rec, int idx)
+{
+  int         i;
+  const char* p = (const char *) (rec + 1);
+  for (i = 0; i < idx; ++i)
+    p += rec->lenA[i] + 1;
+  return p;
+}
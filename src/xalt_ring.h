@@ -0,0 +1,95 @@
+#ifndef XALT_RING_H
+#define XALT_RING_H
+
+#include <stdint.h>
+#include "xalt_obfuscate.h"
+
+/*
+ * Shared memory ring between libxalt_init.so (many producers) and
+ * xalt_collectord (one consumer).  The layout only uses fixed width
+ * types and keeps every 8 byte member 8 byte aligned so that 32 bit and
+ * 64 bit programs agree with the (64 bit) collector.
+ */
+
+#define XALT_RING_MAGIC      0x34474e52544c4158ULL   /* "XALTRNG4" */
+#define XALT_RING_NSLOTS     64
+#define XALT_RING_SLOT_SZ    32768
+#define XALT_RING_STALE      5                       /* seconds without a heartbeat */
+#define XALT_RING_WAIT       2.0                     /* default XALT_COLLECTOR_WAIT */
+#define XALT_RING_GRACE      1.0                     /* seconds the collector drains on shutdown */
+
+/* XALT_RING_ENV is the environment xalt_run_submission would get: the
+ * entries are separated by NULs, so its length is only in lenA. */
+enum { XALT_RING_EXEC = 0, XALT_RING_SYSHOST, XALT_RING_PATH, XALT_RING_LDLIBPATH,
+       XALT_RING_WATERMARK, XALT_RING_CMDLINE, XALT_RING_LIBS, XALT_RING_ENV, XALT_RING_NSTR };
+
+typedef struct
+{
+  double   start_time;
+  double   end_time;
+  double   probability;
+  int64_t  ntasks;
+  int32_t  pid;
+  int32_t  ppid;
+  int32_t  ngpus;
+  int32_t  pad;
+  uint32_t lenA[XALT_RING_NSTR];         /* string lengths, without the trailing NUL */
+  char     kind[16];
+  char     uuid[40];
+  /* followed by the XALT_RING_NSTR strings, each NUL terminated */
+} xalt_ring_rec_t;
+
+typedef struct
+{
+  uint64_t          magic;
+  uint32_t          nslots;
+  uint32_t          slot_sz;
+  volatile uint32_t head;                /* next ticket for producers */
+  volatile uint32_t tail;                /* next ticket for the consumer */
+  volatile uint32_t sleeping;            /* consumer is waiting on wake */
+  volatile uint32_t wake;                /* futex word for the consumer */
+  volatile int32_t  daemon_pid;
+  volatile uint32_t heartbeat;           /* time(NULL) of the consumer's last pass */
+} xalt_ring_hdr_t;
+
+typedef struct
+{
+  volatile uint32_t seq;                 /* slot state, see xalt_ring.c */
+  uint32_t          len;
+  xalt_ring_rec_t   rec;
+} xalt_ring_slot_t;
+
+typedef struct
+{
+  xalt_ring_hdr_t*  hdr;
+  char*             slots;
+  size_t            map_sz;
+} xalt_ring_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+char*             xalt_ring_name(       void);
+
+/* producer side (libxalt_init.so) */
+xalt_ring_t*      xalt_ring_attach(     const char* name);
+int               xalt_ring_push(       xalt_ring_t* ring, const xalt_ring_rec_t* rec,
+                                        const char* strA[], const uint32_t lenIn[], double wait_time);
+void              xalt_ring_detach(     xalt_ring_t* ring);
+
+/* consumer side (xalt_collectord) */
+xalt_ring_t*      xalt_ring_create(     const char* name, uint32_t nslots, uint32_t slot_sz);
+int               xalt_ring_wait(       xalt_ring_t* ring, double timeout);
+xalt_ring_slot_t* xalt_ring_peek(       xalt_ring_t* ring);
+void              xalt_ring_release(    xalt_ring_t* ring);
+int               xalt_ring_empty(      xalt_ring_t* ring);
+void              xalt_ring_destroy(    xalt_ring_t* ring, const char* name);
+const char*       xalt_ring_rec_str(    const xalt_ring_rec_t* rec, int idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XALT_RING_H */
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "xalt_config.h"
+#include "xalt_sha1_cache.h"
+
+/*
+ * A persistent sha1sum cache shared by every XALT program a user runs
+ * on a node.  The cache is a file in XALT_TMPDIR that each program
+ * mmaps.  It is a fixed size open addressing hash table keyed by the
+ * stat fingerprint (dev, inode, size, mtime in ns) of a file.  Each
+ * entry is protected by a sequence lock: readers never block and
+ * simply treat a torn read as a miss, and writers take the lock with a
+ * compare-and-swap and give up if it is busy.  When all
+ * CACHE_PROBE entries a key can live in are in use, the least recently
+ * used one is evicted.
+ *
+ * The cache is per user so that nobody can plant a wrong sha1sum for
+ * another user's libraries.  It is used when XALT_SHA1_CACHE=yes.
+ */
+
+#define CACHE_MAGIC    0x31485341544c4158ULL    /* "XALTSHA1" */
+#define CACHE_NSLOTS   8192                     /* must be a power of two */
+#define CACHE_PROBE    8
+
+typedef struct
+{
+  volatile uint32_t seq;                       /* odd => being written */
+  volatile uint32_t stamp;                     /* time(NULL) of last use */
+  uint64_t          dev;
+  uint64_t          ino;
+  int64_t           size;
+  int64_t           mtime_ns;
+  unsigned char     digest[20];
+  uint32_t          pad;
+} cache_entry_t;
+
+typedef struct
+{
+  uint64_t          magic;
+  volatile uint64_t hits;
+  volatile uint64_t misses;
+  volatile uint64_t evictions;
+  char              pad[32];
+  cache_entry_t     entryA[CACHE_NSLOTS];
+} cache_t;
+
+static cache_t*       cacheG    = NULL;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+
+static void cache_open()
+{
+  struct stat st;
+  const char* v = getenv("XALT_SHA1_CACHE");
+  if (v == NULL || strcmp(v,"yes") != 0)
+    return;
+
+  char* fn = NULL;
+  asprintf(&fn, "%s/XALT_sha1_cache_%u", XALT_TMPDIR, (unsigned int) getuid());
+  int fd = open(fn, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+  free(fn);
+  if (fd < 0)
+    return;
+
+  if (fstat(fd, &st) != 0 || st.st_uid != getuid() ||
+      (st.st_size != 0 && st.st_size != sizeof(cache_t)))
+    {
+      close(fd);
+      return;
+    }
+
+  /* A new file is all zeros which is a valid empty table. */
+  if (st.st_size == 0 && ftruncate(fd, sizeof(cache_t)) != 0)
+    {
+      close(fd);
+      return;
+    }
+
+  void* p = mmap(NULL, sizeof(cache_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return;
+
+  cache_t* cache   = (cache_t *) p;
+  uint64_t zero    = 0;
+  if (! __atomic_compare_exchange_n(&cache->magic, &zero, CACHE_MAGIC, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+      zero != CACHE_MAGIC)
+    {
+      munmap(p, sizeof(cache_t));
+      return;
+    }
+  cacheG = cache;
+}
+
+static cache_t* cache_get()
+{
+  pthread_once(&cacheOnce, cache_open);
+  return cacheG;
+}
+
+static uint32_t cache_hash(const struct stat* st)
+{
+  uint64_t h = (uint64_t) st->st_ino * 0x9E3779B97F4A7C15ULL;
+  h ^= (uint64_t) st->st_dev + 0x7F4A7C159E3779B9ULL + (h << 6) + (h >> 2);
+  return (uint32_t) (h >> 32);
+}
+
+static int64_t mtime_ns(const struct stat* st)
+{
+  return (int64_t) st->st_mtim.tv_sec*1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static int entry_matches(const cache_entry_t* e, const struct stat* st)
+{
+  return e->ino == (uint64_t) st->st_ino && e->dev == (uint64_t) st->st_dev &&
+         e->size == (int64_t) st->st_size && e->mtime_ns == mtime_ns(st);
+}
+
+/* Returns 1 and fills digest if st's fingerprint is in the cache. */
+int xalt_sha1_cache_lookup(const struct stat* st, unsigned char digest[20])
+{
+  int      i;
+  cache_t* cache = cache_get();
+  if (cache == NULL)
+    return 0;
+
+  uint32_t h = cache_hash(st);
+  for (i = 0; i < CACHE_PROBE; ++i)
+    {
+      cache_entry_t* e  = &cache->entryA[(h + i) & (CACHE_NSLOTS - 1)];
+      uint32_t       s1 = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+      if (s1 & 1)
+        continue;
+
+      unsigned char d[20];
+      int           found = entry_matches(e, st);
+      memcpy(d, e->digest, 20);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != s1)
+        continue;
+      if (found)
+        {
+          memcpy(digest, d, 20);
+          e->stamp = (uint32_t) time(NULL);
+          __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+          return 1;
+        }
+    }
+  __atomic_fetch_add(&cache->misses, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+void xalt_sha1_cache_store(const struct stat* st, const unsigned char digest[20])
+{
+  int      i;
+  cache_t* cache = cache_get();
+  if (cache == NULL)
+    return;
+
+  /* Pick the entry: an existing one for this file, else an empty one,
+     else the least recently used one. */
+  uint32_t       h      = cache_hash(st);
+  cache_entry_t* victim = NULL;
+  int            evict  = 1;
+  for (i = 0; i < CACHE_PROBE; ++i)
+    {
+      cache_entry_t* e = &cache->entryA[(h + i) & (CACHE_NSLOTS - 1)];
+      if (e->ino == (uint64_t) st->st_ino && e->dev == (uint64_t) st->st_dev)
+        {
+          victim = e;
+          evict  = 0;
+          break;
+        }
+      if (e->seq == 0 && e->ino == 0)
+        {
+          if (evict)
+            victim = e;
+          evict = 0;
+        }
+      else if (evict && (victim == NULL || e->stamp < victim->stamp))
+        victim = e;
+    }
+
+  uint32_t s = __atomic_load_n(&victim->seq, __ATOMIC_RELAXED);
+  if ((s & 1) || ! __atomic_compare_exchange_n(&victim->seq, &s, s + 1, 0,
+                                               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;   /* someone else is writing it: just skip */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  victim->dev      = (uint64_t) st->st_dev;
+  victim->ino      = (uint64_t) st->st_ino;
+  victim->size     = (int64_t)  st->st_size;
+  victim->mtime_ns = mtime_ns(st);
+  victim->stamp    = (uint32_t) time(NULL);
+  memcpy(victim->digest, digest, 20);
+
+  __atomic_store_n(&victim->seq, s + 2, __ATOMIC_RELEASE);
+  if (evict)
+    __atomic_fetch_add(&cache->evictions, 1, __ATOMIC_RELAXED);
+}
+
+/* Returns 0 and the counters kept in the cache file, -1 if no cache. */
+int xalt_sha1_cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* evictions)
+{
+  cache_t* cache = cache_get();
+  if (cache == NULL)
+    return -1;
+  *hits      = __atomic_load_n(&cache->hits,      __ATOMIC_RELAXED);
+  *misses    = __atomic_load_n(&cache->misses,    __ATOMIC_RELAXED);
+  *evictions = __atomic_load_n(&cache->evictions, __ATOMIC_RELAXED);
+  return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef XALT_SHA1_CACHE_H
+#define XALT_SHA1_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int  xalt_sha1_cache_lookup(const struct stat* st, unsigned char digest[20]);
+void xalt_sha1_cache_store( const struct stat* st, const unsigned char digest[20]);
+int  xalt_sha1_cache_stats( uint64_t* hits, uint64_t* misses, uint64_t* evictions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XALT_SHA1_CACHE_H */
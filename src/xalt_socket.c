@@ -0,0 +1,206 @@
+#define  _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "xalt_socket.h"
+#include "xalt_spool.h"
+#include "xalt_config.h"
+
+#define XALT_SOCKET_TIMEOUT 10         /* ms */
+
+enum { SENT, DROPPED, OVERSIZE };
+
+static int timeout_ms()
+{
+  const char* v = getenv("XALT_SOCKET_TIMEOUT");
+  return v ? atoi(v) : XALT_SOCKET_TIMEOUT;
+}
+
+static long long now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000LL + ts.tv_nsec/1000000;
+}
+
+static xalt_socket_stats_t* map_stats()
+{
+  char                 path[256];
+  const char*          fn = getenv("XALT_SOCKET_STATS");
+  struct stat          st;
+  xalt_socket_stats_t* stats;
+  int                  fd;
+
+  if (fn == NULL)
+    {
+      snprintf(path, sizeof(path), "/dev/shm/xalt_socket_stats.%d", (int) getuid());
+      fn = path;
+    }
+  if ((fd = open(fn, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600)) < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 ||
+      (st.st_size < (off_t) sizeof(*stats) && ftruncate(fd, sizeof(*stats)) != 0))
+    {
+      close(fd);
+      return NULL;
+    }
+  stats = (xalt_socket_stats_t *) mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats == MAP_FAILED)
+    return NULL;
+  if (memcmp(stats->magic, XALT_SOCKET_STATS_MAGIC, 8) != 0)
+    memcpy(stats->magic, XALT_SOCKET_STATS_MAGIC, 8);
+  return stats;
+}
+
+static void count(int what)
+{
+  xalt_socket_stats_t* stats = map_stats();
+  if (stats == NULL)
+    return;
+  uint64_t* c = (what == SENT) ? &stats->sent : (what == OVERSIZE) ? &stats->oversize : &stats->dropped;
+  __atomic_add_fetch(c, 1, __ATOMIC_RELAXED);
+  munmap(stats, sizeof(*stats));
+}
+
+int xalt_socket_read_stats(xalt_socket_stats_t* result)
+{
+  xalt_socket_stats_t* stats = map_stats();
+  if (stats == NULL)
+    return -1;
+  memcpy(result->magic, stats->magic, 8);
+  result->sent     = __atomic_load_n(&stats->sent,     __ATOMIC_RELAXED);
+  result->dropped  = __atomic_load_n(&stats->dropped,  __ATOMIC_RELAXED);
+  result->oversize = __atomic_load_n(&stats->oversize, __ATOMIC_RELAXED);
+  munmap(stats, sizeof(*stats));
+  return 0;
+}
+
+/* Wait until fd is writable or the deadline has passed. */
+static int wait_writable(int fd, long long deadline)
+{
+  struct pollfd pfd = { fd, POLLOUT, 0 };
+  long long     left;
+  int           n;
+  while ((left = deadline - now_ms()) > 0)
+    {
+      n = poll(&pfd, 1, (int) left);
+      if (n > 0)
+        return (pfd.revents & POLLOUT) ? 0 : -1;
+      if (n < 0 && errno != EINTR)
+        return -1;
+    }
+  return -1;
+}
+
+/* Connect to the receiver as a datagram socket, or as a stream socket
+ * when that is what it listens on. */
+static int open_socket(long long deadline)
+{
+  struct sockaddr_un addr;
+  const char*        path = getenv("XALT_SOCKET_PATH");
+  int                types[2] = { SOCK_DGRAM, SOCK_STREAM };
+  int                i, fd, err;
+  socklen_t          errLen = sizeof(err);
+
+  if (path == NULL)
+    path = XALT_SOCKET_PATH;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  for (i = 0; i < 2; i++)
+    {
+      fd = socket(AF_UNIX, types[i] | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+      if (fd < 0)
+        return -1;
+      if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+        return fd;
+      if ((errno == EAGAIN || errno == EINPROGRESS) && wait_writable(fd, deadline) == 0 &&
+          getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0)
+        return fd;
+      err = errno;
+      close(fd);
+      if (err != EPROTOTYPE)
+        break;
+    }
+  return -1;
+}
+
+int xalt_socket_send(const char* kind, const char* rec, size_t len)
+{
+  unsigned char hdr[XALT_SPOOL_HDR_SZ];
+  struct iovec  iov[2];
+  struct msghdr msg;
+  long long     deadline = now_ms() + timeout_ms();
+  size_t        left     = sizeof(hdr) + len;
+  int           fd;
+  int           result   = DROPPED;
+
+  if ((fd = open_socket(deadline)) < 0)
+    {
+      count(DROPPED);
+      return -1;
+    }
+
+  xalt_spool_frame(hdr, kind, rec, len);
+  iov[0].iov_base = hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  iov[1].iov_base = (void *) rec;
+  iov[1].iov_len  = len;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = 2;
+
+  while (left > 0)
+    {
+      ssize_t n = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n >= 0)
+        {
+          // A datagram goes whole; a stream can take part of the frame.
+          left -= n;
+          while (n > 0 && msg.msg_iovlen > 0)
+            {
+              size_t k = ((size_t) n < msg.msg_iov[0].iov_len) ? (size_t) n : msg.msg_iov[0].iov_len;
+              msg.msg_iov[0].iov_base  = (char *) msg.msg_iov[0].iov_base + k;
+              msg.msg_iov[0].iov_len  -= k;
+              n                       -= k;
+              if (msg.msg_iov[0].iov_len == 0)
+                {
+                  msg.msg_iov++;
+                  msg.msg_iovlen--;
+                }
+            }
+          if (left == 0)
+            result = SENT;
+          continue;
+        }
+      if (errno == EINTR)
+        continue;
+      if (errno == EMSGSIZE)
+        result = OVERSIZE;
+      else if ((errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) &&
+               wait_writable(fd, deadline) == 0)
+        continue;
+      break;
+    }
+
+  close(fd);
+  count(result);
+  if (result == OVERSIZE)
+    return 1;
+  return (result == SENT) ? 0 : -1;
+}
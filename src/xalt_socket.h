@@ -0,0 +1,49 @@
+#ifndef XALT_SOCKET_H
+#define XALT_SOCKET_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * The socket transmission sends each record to a local agent listening
+ * on the Unix socket XALT_SOCKET_PATH, framed as in a spool segment
+ * (see xalt_spool.h).  A datagram socket gets one datagram per record;
+ * a stream socket gets the frames one after the other.  Nothing blocks
+ * for longer than XALT_SOCKET_TIMEOUT ms (10 by default): a record that
+ * cannot be sent by then is parked by transmit_record() in the retry
+ * queue (see xalt_retry.h).  A record too big for a datagram is dropped.
+ *
+ * What happened to the records is counted in a small file shared by all
+ * the processes of a user on the node, XALT_SOCKET_STATS
+ * (/dev/shm/xalt_socket_stats.<uid> by default).  A record is counted
+ * as dropped each time it cannot be sent, even if a replay from the
+ * retry queue delivers it later, and then it is counted as sent too.
+ */
+
+#define XALT_SOCKET_STATS_MAGIC "XSKSTAT1"
+
+typedef struct
+{
+  char     magic[8];
+  uint64_t sent;
+  uint64_t dropped;       /* receiver missing, busy or too slow */
+  uint64_t oversize;      /* too big for a datagram */
+} xalt_socket_stats_t;
+
+/* Send len bytes of rec as a record of kind.  Returns 0 when it was
+ * sent, 1 when it is too big for a datagram (resending cannot help) and
+ * -1 otherwise. */
+int  xalt_socket_send(const char* kind, const char* rec, size_t len);
+
+/* Copy the counters to *stats.  Returns 0 on success. */
+int  xalt_socket_read_stats(xalt_socket_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_SOCKET_H
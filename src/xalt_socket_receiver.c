@@ -0,0 +1,245 @@
+// xalt_socket_receiver: a reference receiver for the socket transmission.
+// It listens on the socket, checks each record and appends it to the
+// spool segments of this node (see xalt_spool.h) where xalt_file_to_db
+// picks them up.
+//
+//    xalt_socket_receiver [--stream] [-s sockPath] [-d spoolDir] [-S syshost]
+//    xalt_socket_receiver --stats
+//
+// --stream listens on a stream socket instead of a datagram socket.
+// --stats reports the counters kept by the senders of this user.
+
+#define  _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "xalt_socket.h"
+#include "xalt_spool.h"
+#include "xalt_config.h"
+#include "xalt_obfuscate.h"
+
+#define MAX_CLIENTS  64
+#define MAX_RECORD   (64L << 20)
+#define DGRAM_BUF_SZ (4 << 20)
+
+const char* xalt_syshost();
+
+typedef struct
+{
+  int    fd;
+  char*  buf;
+  size_t len;
+  size_t cap;
+} client_t;
+
+static volatile sig_atomic_t doneG = 0;
+static long                  numRecG = 0;
+static long                  numBadG = 0;
+
+static void on_signal(int sig)
+{
+  doneG = sig;
+}
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "Usage: %s [--stream] [-s sockPath] [-d spoolDir] [-S syshost]\n"
+                  "       %s --stats\n", prog, prog);
+  exit(1);
+}
+
+static void store(const char* syshost, const unsigned char* frame, size_t len)
+{
+  char  kind[5];
+  long  recLen = xalt_spool_frame_len(frame);
+  const char* rec = (const char *) frame + XALT_SPOOL_HDR_SZ;
+
+  if (recLen < 0 || (size_t) recLen != len - XALT_SPOOL_HDR_SZ ||
+      ! xalt_spool_check_frame(frame, rec, recLen))
+    {
+      numBadG++;
+      return;
+    }
+  memcpy(kind, &frame[12], 4);
+  kind[4] = '\0';
+  if (xalt_spool_append(kind, syshost, rec, recLen) == 0)
+    numRecG++;
+  else
+    numBadG++;
+}
+
+/* Take the whole frames out of a stream client's buffer.  Returns -1
+ * when the client sent something that is not a frame. */
+static int drain(client_t* c, const char* syshost)
+{
+  size_t pos = 0;
+  while (c->len - pos >= XALT_SPOOL_HDR_SZ)
+    {
+      long recLen = xalt_spool_frame_len((unsigned char *) &c->buf[pos]);
+      if (recLen < 0 || recLen > MAX_RECORD)
+        return -1;
+      if (c->len - pos < XALT_SPOOL_HDR_SZ + (size_t) recLen)
+        break;
+      store(syshost, (unsigned char *) &c->buf[pos], XALT_SPOOL_HDR_SZ + recLen);
+      pos += XALT_SPOOL_HDR_SZ + recLen;
+    }
+  memmove(c->buf, &c->buf[pos], c->len - pos);
+  c->len -= pos;
+  return 0;
+}
+
+static int print_stats()
+{
+  xalt_socket_stats_t stats;
+  if (xalt_socket_read_stats(&stats) != 0)
+    {
+      fprintf(stderr, "Unable to read the socket counters\n");
+      return 1;
+    }
+  printf("sent: %llu, dropped: %llu, oversize: %llu\n", (unsigned long long) stats.sent,
+         (unsigned long long) stats.dropped, (unsigned long long) stats.oversize);
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  struct sockaddr_un addr;
+  struct pollfd      pfd[MAX_CLIENTS+1];
+  client_t           clientA[MAX_CLIENTS];
+  const char*        path    = getenv("XALT_SOCKET_PATH");
+  const char*        syshost = NULL;
+  int                type    = SOCK_DGRAM;
+  int                nc      = 0;
+  int                i, fd;
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (strcmp(argv[i], "--stats") == 0)
+        return print_stats();
+      else if (strcmp(argv[i], "--stream") == 0)
+        type = SOCK_STREAM;
+      else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        path = argv[++i];
+      else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        setenv("XALT_SPOOL_DIR", argv[++i], 1);
+      else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+        syshost = argv[++i];
+      else
+        usage(argv[0]);
+    }
+  if (path == NULL)
+    path = XALT_SOCKET_PATH;
+  if (syshost == NULL && (syshost = xalt_syshost()) == NULL)
+    syshost = "unknown";
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+    {
+      fprintf(stderr, "%s: socket path too long: %s\n", argv[0], path);
+      return 1;
+    }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+  unlink(path);
+  if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+      (type == SOCK_STREAM && listen(fd, 128) != 0))
+    {
+      fprintf(stderr, "%s: unable to listen on %s: %s\n", argv[0], path, strerror(errno));
+      return 1;
+    }
+  // Every user's processes send to the socket.
+  chmod(path, 0666);
+  if (type == SOCK_DGRAM)
+    {
+      int sz = DGRAM_BUF_SZ;
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    }
+
+  signal(SIGINT,  on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  char* dgram = (type == SOCK_DGRAM) ? (char *) malloc(DGRAM_BUF_SZ) : NULL;
+
+  while (! doneG)
+    {
+      pfd[0].fd     = fd;
+      pfd[0].events = POLLIN;
+      for (i = 0; i < nc; i++)
+        {
+          pfd[i+1].fd     = clientA[i].fd;
+          pfd[i+1].events = POLLIN;
+        }
+      int npolled = nc;
+      if (poll(pfd, npolled+1, 1000) <= 0)
+        continue;
+
+      if (pfd[0].revents & POLLIN)
+        {
+          if (type == SOCK_DGRAM)
+            {
+              ssize_t n;
+              while ((n = recv(fd, dgram, DGRAM_BUF_SZ, MSG_DONTWAIT | MSG_TRUNC)) >= 0)
+                {
+                  if (n > DGRAM_BUF_SZ)
+                    numBadG++;
+                  else
+                    store(syshost, (unsigned char *) dgram, n);
+                }
+            }
+          else
+            {
+              int cfd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+              if (cfd >= 0 && nc < MAX_CLIENTS)
+                {
+                  clientA[nc].fd  = cfd;
+                  clientA[nc].len = 0;
+                  clientA[nc].cap = 65536;
+                  clientA[nc].buf = (char *) malloc(clientA[nc].cap);
+                  nc++;
+                }
+              else if (cfd >= 0)
+                close(cfd);
+            }
+        }
+
+      for (i = npolled - 1; i >= 0; i--)
+        {
+          client_t* c = &clientA[i];
+          ssize_t   n = 0;
+          if ((pfd[i+1].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+            continue;
+          if (c->cap - c->len < 65536)
+            {
+              c->cap *= 2;
+              c->buf  = (char *) realloc(c->buf, c->cap);
+            }
+          n = read(c->fd, &c->buf[c->len], c->cap - c->len);
+          if (n > 0)
+            c->len += n;
+          if ((n < 0 && errno != EAGAIN && errno != EINTR) || drain(c, syshost) != 0 || n == 0)
+            {
+              // A frame cut short by a sender that timed out is lost.
+              if (c->len > 0)
+                numBadG++;
+              close(c->fd);
+              free(c->buf);
+              clientA[i] = clientA[--nc];
+            }
+        }
+    }
+
+  unlink(path);
+  fprintf(stderr, "%s: stored %ld records, rejected %ld\n", argv[0], numRecG, numBadG);
+  return 0;
+}
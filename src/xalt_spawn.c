@@ -0,0 +1,137 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "xalt_spawn.h"
+
+extern char **environ;
+
+static double wall_time()
+{
+  struct timeval tm;
+  gettimeofday(&tm, 0);
+  return tm.tv_sec + 1.0e-6*tm.tv_usec;
+}
+
+/*
+ * Build the environment for xalt_run_submission: a copy of the
+ * current environment where LD_LIBRARY_PATH and PATH are replaced by
+ * the values XALT was built with and LD_PRELOAD and LD_AUDIT are
+ * dropped.  The two replaced entries are always stored in envp[0] and
+ * envp[1] so that xalt_spawn_env_free() knows what to free.
+ */
+char** xalt_spawn_env(const char* ld_library_path, const char* path)
+{
+  int    i, j;
+  int    n    = 0;
+  char** envp;
+
+  while (environ[n])
+    n++;
+
+  envp = (char **) malloc((n + 3)*sizeof(char *));
+  if (envp == NULL)
+    return NULL;
+
+  asprintf(&envp[0], "LD_LIBRARY_PATH=%s", ld_library_path);
+  asprintf(&envp[1], "PATH=%s",            path);
+  j = 2;
+
+  for (i = 0; i < n; ++i)
+    {
+      const char* w = environ[i];
+      if (strncmp(w, "LD_LIBRARY_PATH=", 16) == 0 ||
+          strncmp(w, "PATH=",             5) == 0 ||
+          strncmp(w, "LD_PRELOAD=",      11) == 0 ||
+          strncmp(w, "LD_AUDIT=",         9) == 0)
+        continue;
+      envp[j++] = (char *) w;
+    }
+  envp[j] = NULL;
+  return envp;
+}
+
+void xalt_spawn_env_free(char** envp)
+{
+  if (envp == NULL)
+    return;
+  free(envp[0]);
+  free(envp[1]);
+  free(envp);
+}
+
+/*
+ * Launch path with an explicit argv and envp.  There is no shell in
+ * between: posix_spawn() uses vfork semantics so the (possibly huge)
+ * address space of the user's program is never copied.  If
+ * wait_for_child is non-zero then this routine waits for the child and
+ * returns its exit status, otherwise it returns 0 as soon as the child
+ * has been started.  Returns -1 if the child could not be started.
+ * The time spent launching the child is stored in *t_launch.
+ */
+int xalt_spawn(const char* path, char* const argv[], char* const envp[], int wait_for_child,
+               double* t_launch)
+{
+  pid_t             child;
+  int               status = 0;
+  int               err;
+  short             flags  = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+  double            t0;
+  sigset_t          chld_mask, old_mask, child_mask, child_dflt;
+  posix_spawnattr_t attr;
+
+  /* Like system(): keep the user's SIGCHLD handler from reaping our child */
+  sigemptyset(&chld_mask);
+  sigaddset(&chld_mask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+  /* The child starts with no blocked signals and every handler reset */
+  sigemptyset(&child_mask);
+  sigfillset(&child_dflt);
+  sigdelset(&child_dflt, SIGKILL);
+  sigdelset(&child_dflt, SIGSTOP);
+
+#ifdef POSIX_SPAWN_USEVFORK
+  flags |= POSIX_SPAWN_USEVFORK;
+#endif
+
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, flags);
+  posix_spawnattr_setsigmask(&attr, &child_mask);
+  posix_spawnattr_setsigdefault(&attr, &child_dflt);
+
+  t0  = wall_time();
+  err = posix_spawn(&child, path, NULL, &attr, argv, envp);
+  if (t_launch)
+    *t_launch = wall_time() - t0;
+  posix_spawnattr_destroy(&attr);
+
+  if (err != 0)
+    {
+      sigprocmask(SIG_SETMASK, &old_mask, NULL);
+      errno = err;
+      return -1;
+    }
+
+  if (wait_for_child)
+    {
+      while (waitpid(child, &status, 0) == -1)
+        {
+          if (errno != EINTR)
+            {
+              status = 0;
+              break;
+            }
+        }
+    }
+
+  sigprocmask(SIG_SETMASK, &old_mask, NULL);
+  return status;
+}
@@ -0,0 +1,20 @@
+#ifndef XALT_SPAWN_H
+#define XALT_SPAWN_H
+
+#include "xalt_obfuscate.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+char** xalt_spawn_env(      const char* ld_library_path, const char* path);
+void   xalt_spawn_env_free( char** envp);
+int    xalt_spawn(          const char* path, char* const argv[], char* const envp[], int wait_for_child,
+                            double* t_launch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XALT_SPAWN_H */
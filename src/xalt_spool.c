@@ -0,0 +1,308 @@
+#define  _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "xalt_spool.h"
+#include "xalt_config.h"
+#include "xalt_c_utils.h"
+
+#define XALT_SPOOL_MAX_SIZE (64UL << 20)   /* seal segments at 64 MiB */
+#define XALT_SPOOL_TRIES    64
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+  int i;
+  for (i = 0; i < 4; i++)
+    p[i] = (unsigned char) (v >> (8*i));
+}
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+  int i;
+  for (i = 0; i < 8; i++)
+    p[i] = (unsigned char) (v >> (8*i));
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+void xalt_spool_frame(unsigned char* hdr, const char* kind, const char* rec, size_t len)
+{
+  size_t kindLen = strlen(kind);
+  memcpy(hdr, XALT_SPOOL_REC_MAGIC, 4);
+  put_u32(&hdr[4], (uint32_t) len);
+  put_u32(&hdr[8], (uint32_t) crc32(0L, (const Bytef *) rec, len));
+  memset(&hdr[12], 0, 4);
+  memcpy(&hdr[12], kind, kindLen < 4 ? kindLen : 4);
+}
+
+long xalt_spool_frame_len(const unsigned char* hdr)
+{
+  return (memcmp(hdr, XALT_SPOOL_REC_MAGIC, 4) == 0) ? (long) get_u32(&hdr[4]) : -1;
+}
+
+int xalt_spool_check_frame(const unsigned char* hdr, const char* rec, size_t len)
+{
+  return memcmp(hdr, XALT_SPOOL_REC_MAGIC, 4) == 0 && get_u32(&hdr[4]) == len &&
+    get_u32(&hdr[8]) == (uint32_t) crc32(0L, (const Bytef *) rec, len);
+}
+
+/* XALT_SPOOL_DIR, or "spool" next to where the file transmission writes. */
+static char* spool_dir()
+{
+  const char* dir    = getenv("XALT_SPOOL_DIR");
+  const char* prefix = getenv("XALT_FILE_PREFIX");
+  const char* home   = getenv("HOME");
+  char*       result = NULL;
+
+  if (dir == NULL)
+    dir = XALT_SPOOL_DIR;
+  if (dir[0] != '\0')
+    {
+      asprintf(&result, "%s/", dir);
+      return result;
+    }
+
+  if (prefix == NULL)
+    prefix = XALT_FILE_PREFIX;
+  if (strcasecmp(prefix, "USE_HOME") != 0)
+    asprintf(&result, "%s/spool/", prefix);
+  else if (home != NULL)
+    asprintf(&result, "%s/.xalt.d/spool/", home);
+  return result;
+}
+
+static size_t max_size()
+{
+  const char* v = getenv("XALT_SPOOL_MAX_SIZE");
+  size_t      sz;
+  if (v == NULL || (sz = strtoull(v, NULL, 10)) == 0)
+    sz = XALT_SPOOL_MAX_SIZE;
+  return sz;
+}
+
+/* Append the index footer to the segment open on fd (which must be
+ * locked) and rename it from openFn to its sealed name. */
+static int seal_segment(int fd, const char* openFn)
+{
+  struct stat          st;
+  struct timeval       tv;
+  const unsigned char* seg;
+  unsigned char*       idx;
+  char*                sealedFn = NULL;
+  size_t               n        = 0;
+  size_t               cap      = 1024;
+  size_t               pos      = 0;
+  size_t               size;
+  int                  err;
+
+  if (fstat(fd, &st) != 0)
+    return -1;
+  size = st.st_size;
+
+  seg = NULL;
+  if (size > 0 &&
+      (seg = (const unsigned char *) mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    return -1;
+
+  idx = (unsigned char *) malloc(cap*XALT_SPOOL_IDX_SZ + XALT_SPOOL_TRAILER_SZ);
+  if (idx == NULL)
+    {
+      if (seg)
+        munmap((void *) seg, size);
+      return -1;
+    }
+
+  // Walk the records.  A torn or damaged record (a writer killed in the
+  // middle of its write, a full file system) is skipped up to the next
+  // record that checks out.
+  while (pos + XALT_SPOOL_HDR_SZ <= size)
+    {
+      uint32_t len = get_u32(&seg[pos+4]);
+      if (memcmp(&seg[pos], XALT_SPOOL_REC_MAGIC, 4) == 0 &&
+          len <= size - pos - XALT_SPOOL_HDR_SZ &&
+          get_u32(&seg[pos+8]) == (uint32_t) crc32(0L, &seg[pos+XALT_SPOOL_HDR_SZ], len))
+        {
+          if (n == cap)
+            {
+              unsigned char* p;
+              cap *= 2;
+              if ((p = (unsigned char *) realloc(idx, cap*XALT_SPOOL_IDX_SZ + XALT_SPOOL_TRAILER_SZ)) == NULL)
+                break;
+              idx = p;
+            }
+          unsigned char* e = &idx[n*XALT_SPOOL_IDX_SZ];
+          put_u64(e, pos);
+          put_u32(e + 8, len);
+          memcpy(e + 12, &seg[pos+12], 4);
+          n++;
+          pos += XALT_SPOOL_HDR_SZ + len;
+          continue;
+        }
+      const unsigned char* next = (const unsigned char *) memmem(&seg[pos+1], size - pos - 1,
+                                                                 XALT_SPOOL_REC_MAGIC, 4);
+      if (next == NULL)
+        break;
+      pos = next - seg;
+    }
+  if (seg)
+    munmap((void *) seg, size);
+
+  unsigned char* t = &idx[n*XALT_SPOOL_IDX_SZ];
+  put_u64(t, size);
+  put_u32(t + 8, (uint32_t) n);
+  put_u32(t + 12, (uint32_t) crc32(0L, idx, n*XALT_SPOOL_IDX_SZ));
+  memcpy(t + 16, XALT_SPOOL_END_MAGIC, 8);
+  err = write_all(fd, (const char *) idx, n*XALT_SPOOL_IDX_SZ + XALT_SPOOL_TRAILER_SZ);
+  free(idx);
+  if (err)
+    return -1;
+
+  gettimeofday(&tv, NULL);
+  asprintf(&sealedFn, "%.*s.%ld_%06ld_%d.xseg", (int) (strlen(openFn) - 5), openFn,
+           (long) tv.tv_sec, (long) tv.tv_usec, (int) getpid());
+  err = rename(openFn, sealedFn);
+  free(sealedFn);
+  return err;
+}
+
+/* Lock fd and make sure it is still the segment named fn: another
+ * process may have sealed and renamed it after we opened it. */
+static int lock_segment(int fd, const char* fn, struct stat* st)
+{
+  struct stat pst;
+  if (flock(fd, LOCK_EX) != 0 && errno != ENOLCK && errno != EOPNOTSUPP)
+    return -1;
+  if (fstat(fd, st) != 0 || stat(fn, &pst) != 0)
+    return -1;
+  return (st->st_ino == pst.st_ino && st->st_dev == pst.st_dev) ? 0 : -1;
+}
+
+/* Seal this node's segments of earlier hours that are still open. */
+static void seal_stale(const char* dir, const char* stem, const char* curFn)
+{
+  DIR*           dirp = opendir(dir);
+  struct dirent* dp;
+  size_t         slen = strlen(stem);
+
+  if (dirp == NULL)
+    return;
+  while ((dp = readdir(dirp)) != NULL)
+    {
+      size_t nlen = strlen(dp->d_name);
+      if (nlen <= 5 || strncmp(dp->d_name, stem, slen) != 0 ||
+          strcmp(&dp->d_name[nlen-5], ".open") != 0 || strcmp(dp->d_name, curFn) == 0)
+        continue;
+
+      char*       fn = NULL;
+      struct stat st;
+      int         fd;
+      asprintf(&fn, "%s%s", dir, dp->d_name);
+      if ((fd = open(fn, O_RDWR | O_APPEND | O_CLOEXEC)) >= 0)
+        {
+          if (lock_segment(fd, fn, &st) == 0)
+            seal_segment(fd, fn);
+          close(fd);
+        }
+      free(fn);
+    }
+  closedir(dirp);
+}
+
+int xalt_spool_append(const char* kind, const char* syshost, const char* rec, size_t len)
+{
+  unsigned char  hdr[XALT_SPOOL_HDR_SZ];
+  struct iovec   iov[2];
+  struct utsname u;
+  struct stat    st;
+  struct tm      tm;
+  time_t         now;
+  char           hour[32];
+  char*          dir   = spool_dir();
+  char*          stem  = NULL;
+  char*          curFn = NULL;
+  char*          fn    = NULL;
+  char*          p;
+  int            fd, i;
+  int            result = -1;
+
+  if (dir == NULL || len > UINT32_MAX)
+    {
+      free(dir);
+      return -1;
+    }
+
+  if (uname(&u) != 0)
+    strcpy(u.nodename, "unknown");
+  if ((p = strchr(u.nodename, '.')) != NULL)
+    *p = '\0';
+  now = time(NULL);
+  localtime_r(&now, &tm);
+  strftime(hour, sizeof(hour), "%Y_%m_%d_%H", &tm);
+
+  asprintf(&stem,  "%s.%s.%d.", syshost, u.nodename, (int) getuid());
+  asprintf(&curFn, "%s%s.open", stem, hour);
+  asprintf(&fn,    "%s%s", dir, curFn);
+
+  xalt_spool_frame(hdr, kind, rec, len);
+  iov[0].iov_base = hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  iov[1].iov_base = (void *) rec;
+  iov[1].iov_len  = len;
+
+  for (i = 0; i < XALT_SPOOL_TRIES; i++)
+    {
+      fd = open(fn, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+      if (fd < 0)
+        {
+          if (i > 0 || mkpath(dir, 0755) != 0)
+            break;
+          continue;
+        }
+      if (lock_segment(fd, fn, &st) != 0)
+        {
+          // Sealed under us: the next open() starts a new segment.
+          close(fd);
+          continue;
+        }
+
+      // One write per record so that, even where flock() does not reach
+      // the other nodes, O_APPEND keeps the records whole.
+      ssize_t n = writev(fd, iov, 2);
+      if (n == (ssize_t) (sizeof(hdr) + len))
+        {
+          result = 0;
+          if ((size_t) st.st_size + n >= max_size())
+            seal_segment(fd, fn);
+        }
+      close(fd);
+
+      // The first record of a segment: look for segments of earlier
+      // hours to seal.
+      if (result == 0 && st.st_size == 0)
+        seal_stale(dir, stem, curFn);
+      break;
+    }
+
+  free(stem);
+  free(curFn);
+  free(fn);
+  free(dir);
+  return result;
+}
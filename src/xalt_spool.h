@@ -0,0 +1,56 @@
+#ifndef XALT_SPOOL_H
+#define XALT_SPOOL_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * The spool transmission appends records to a segment file instead of
+ * writing one file per record.  There is one segment per syshost, node,
+ * user and hour in XALT_SPOOL_DIR ($XALT_FILE_PREFIX/spool or
+ * $HOME/.xalt.d/spool by default):
+ *
+ *     <syshost>.<node>.<uid>.<YYYY_MM_DD_HH>.open
+ *
+ * Each record is framed as (all numbers little endian)
+ *
+ *     "XSR1" | u32 length | u32 crc32(payload) | kind[4] | payload
+ *
+ * and is appended with a single O_APPEND write while holding flock().
+ * A segment is sealed once it reaches XALT_SPOOL_MAX_SIZE bytes or its
+ * hour has passed: an index of its records is appended,
+ *
+ *     n * (u64 offset | u32 length | kind[4])
+ *     u64 index offset | u32 n | u32 crc32(index) | "XSEGEND1"
+ *
+ * and it is renamed to <syshost>.<node>.<uid>.<YYYY_MM_DD_HH>.<stamp>.xseg
+ * where xalt_file_to_db picks it up.
+ */
+
+#define XALT_SPOOL_REC_MAGIC  "XSR1"
+#define XALT_SPOOL_END_MAGIC  "XSEGEND1"
+#define XALT_SPOOL_HDR_SZ     16
+#define XALT_SPOOL_IDX_SZ     16
+#define XALT_SPOOL_TRAILER_SZ 24
+
+/* Fill in the XALT_SPOOL_HDR_SZ byte frame header of a record of kind.
+ * The socket transmission sends records in the same frames. */
+void xalt_spool_frame(unsigned char* hdr, const char* kind, const char* rec, size_t len);
+
+/* The record length in the frame header hdr, -1 if it is not one. */
+long xalt_spool_frame_len(const unsigned char* hdr);
+
+/* Is hdr the frame header of the len bytes of rec? */
+int  xalt_spool_check_frame(const unsigned char* hdr, const char* rec, size_t len);
+
+/* Append len bytes of rec as a record of kind.  Returns 0 on success. */
+int  xalt_spool_append(const char* kind, const char* syshost, const char* rec, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_SPOOL_H
@@ -0,0 +1,216 @@
+#define  _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "xalt_syslog.h"
+
+#define XALT_SYSLOG_PRI      13        /* user.notice, the logger(1) default */
+#define XALT_SYSLOG_BATCH    64        /* messages per sendmmsg() */
+#define XALT_SYSLOG_RETRIES  10        /* back-off of 1, 2, ... 512 ms: about 1 s */
+#define XALT_SYSLOG_MAX_WAIT 2000      /* ms of back-off in all for one record */
+
+static xalt_syslog_stats_t* map_stats()
+{
+  char                 path[256];
+  const char*          fn = getenv("XALT_SYSLOG_STATS");
+  struct stat          st;
+  xalt_syslog_stats_t* stats;
+  int                  fd;
+
+  if (fn == NULL)
+    {
+      snprintf(path, sizeof(path), "/dev/shm/xalt_syslog_stats.%d", (int) getuid());
+      fn = path;
+    }
+  if ((fd = open(fn, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600)) < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 ||
+      (st.st_size < (off_t) sizeof(*stats) && ftruncate(fd, sizeof(*stats)) != 0))
+    {
+      close(fd);
+      return NULL;
+    }
+  stats = (xalt_syslog_stats_t *) mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats == MAP_FAILED)
+    return NULL;
+  if (memcmp(stats->magic, XALT_SYSLOG_STATS_MAGIC, 8) != 0)
+    memcpy(stats->magic, XALT_SYSLOG_STATS_MAGIC, 8);
+  return stats;
+}
+
+static void count(int sent, int dropped)
+{
+  xalt_syslog_stats_t* stats = map_stats();
+  if (stats == NULL)
+    return;
+  __atomic_add_fetch(&stats->sent,    (uint64_t) sent,    __ATOMIC_RELAXED);
+  __atomic_add_fetch(&stats->dropped, (uint64_t) dropped, __ATOMIC_RELAXED);
+  munmap(stats, sizeof(*stats));
+}
+
+int xalt_syslog_read_stats(xalt_syslog_stats_t* result)
+{
+  xalt_syslog_stats_t* stats = map_stats();
+  if (stats == NULL)
+    return -1;
+  memcpy(result->magic, stats->magic, 8);
+  result->sent    = __atomic_load_n(&stats->sent,    __ATOMIC_RELAXED);
+  result->dropped = __atomic_load_n(&stats->dropped, __ATOMIC_RELAXED);
+  munmap(stats, sizeof(*stats));
+  return 0;
+}
+
+/* XALT_SYSLOG_SOCKET can point somewhere other than /dev/log. */
+static int open_socket()
+{
+  struct sockaddr_un addr;
+  const char*        path = getenv("XALT_SYSLOG_SOCKET");
+  int                fd;
+
+  if (path == NULL)
+    path = "/dev/log";
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+    {
+      close(fd);
+      return -1;
+    }
+  return fd;
+}
+
+/*
+ * By default the header is the one logger(1) and syslog(3) use on the
+ * local socket ("<13>Oct 17 22:21:33 tag[pid]: ") which every syslog
+ * daemon understands.  XALT_SYSLOG_FORMAT=rfc5424 gives an RFC 5424
+ * header instead.
+ */
+static int build_header(char* hdr, size_t sz, const char* tag)
+{
+  const char*     fmt = getenv("XALT_SYSLOG_FORMAT");
+  char            tbuf[64];
+  struct timespec ts;
+  struct tm       tm;
+  int             n;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  localtime_r(&ts.tv_sec, &tm);
+
+  if (fmt && strcasecmp(fmt, "rfc5424") == 0)
+    {
+      char host[256];
+      char zone[8];
+      if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "-");
+      host[sizeof(host)-1] = '\0';
+      strftime(zone, sizeof(zone), "%z", &tm);
+      strftime(tbuf, sizeof(tbuf), "%Y-%m-%dT%H:%M:%S", &tm);
+      n = snprintf(hdr, sz, "<%d>1 %s.%06ld%.3s:%s %s %s %d - - ", XALT_SYSLOG_PRI, tbuf,
+                   ts.tv_nsec/1000, zone, &zone[3], host, tag, (int) getpid());
+    }
+  else
+    {
+      strftime(tbuf, sizeof(tbuf), "%b %e %H:%M:%S", &tm);
+      n = snprintf(hdr, sz, "<%d>%s %s[%d]: ", XALT_SYSLOG_PRI, tbuf, tag, (int) getpid());
+    }
+  return (n < (int) sz) ? n : (int) sz - 1;
+}
+
+int xalt_syslog(const char* tag, int nmsg, char** msgA, const int* lenA)
+{
+  struct mmsghdr msgv[XALT_SYSLOG_BATCH];
+  struct iovec   iov[XALT_SYSLOG_BATCH][2];
+  char           hdr[512];
+  int            hlen, fd, k, n, sent;
+  int            i           = 0;
+  int            dropped     = 0;
+  int            retries     = 0;
+  int            reconnected = 0;
+  long           waited      = 0;
+
+  fd = open_socket();
+  if (fd < 0)
+    return -1;
+  hlen = build_header(hdr, sizeof(hdr), tag);
+
+  while (i < nmsg)
+    {
+      n = nmsg - i;
+      if (n > XALT_SYSLOG_BATCH)
+        n = XALT_SYSLOG_BATCH;
+      memset(msgv, 0, n*sizeof(msgv[0]));
+      for (k = 0; k < n; ++k)
+        {
+          iov[k][0].iov_base          = hdr;
+          iov[k][0].iov_len           = hlen;
+          iov[k][1].iov_base          = msgA[i+k];
+          iov[k][1].iov_len           = lenA[i+k];
+          msgv[k].msg_hdr.msg_iov    = iov[k];
+          msgv[k].msg_hdr.msg_iovlen = 2;
+        }
+
+      // Never block: a stuck syslog daemon must not hang the user's job.
+      sent = sendmmsg(fd, msgv, n, MSG_DONTWAIT);
+      if (sent > 0)
+        {
+          i      += sent;
+          retries = 0;
+          continue;
+        }
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) &&
+          retries < XALT_SYSLOG_RETRIES && waited < XALT_SYSLOG_MAX_WAIT)
+        {
+          struct timespec delay = { 0, 1000000L << retries };
+          nanosleep(&delay, NULL);
+          waited += 1L << retries;
+          retries++;
+          continue;
+        }
+      if ((errno == ECONNREFUSED || errno == ENOTCONN) && ! reconnected)
+        {
+          // The daemon was restarted.
+          close(fd);
+          reconnected = 1;
+          if ((fd = open_socket()) >= 0)
+            continue;
+        }
+      if (errno == EMSGSIZE)
+        {
+          // Only this message is too big for the socket.
+          dropped++;
+          i++;
+          continue;
+        }
+
+      // Still busy after the retries (or the socket is gone): give up.
+      dropped += nmsg - i;
+      break;
+    }
+
+  if (fd >= 0)
+    close(fd);
+  count(nmsg - dropped, dropped);
+  return dropped;
+}
@@ -0,0 +1,42 @@
+#ifndef XALT_SYSLOG_H
+#define XALT_SYSLOG_H
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Send nmsg messages (msgA[i] is lenA[i] bytes long) to the local syslog
+ * socket with the given tag, as "logger -t tag msg" would, but without
+ * running a shell and logger(1) for each one.  The messages are sent in
+ * batches with sendmmsg().  Returns the number of messages dropped after
+ * the syslog daemon stayed busy through the retries, or -1 (nothing
+ * sent) when the socket cannot be used at all.
+ */
+int xalt_syslog(const char* tag, int nmsg, char** msgA, const int* lenA);
+
+/*
+ * The messages sent and dropped are counted in a small file shared by
+ * all the processes of a user on the node, XALT_SYSLOG_STATS
+ * (/dev/shm/xalt_syslog_stats.<uid> by default).
+ */
+
+#define XALT_SYSLOG_STATS_MAGIC "XSLSTAT1"
+
+typedef struct
+{
+  char     magic[8];
+  uint64_t sent;
+  uint64_t dropped;       /* daemon busy, socket gone or message too big */
+} xalt_syslog_stats_t;
+
+/* Copy the counters to *stats.  Returns 0 on success. */
+int xalt_syslog_read_stats(xalt_syslog_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XALT_SYSLOG_H
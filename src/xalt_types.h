@@ -18,11 +18,25 @@ typedef unsigned int                                uint;
 
 struct Libpair
 {
-  Libpair(const std::string& libIn, const std::string& sha1In)
-    : lib(libIn), sha1(sha1In) {}
+  Libpair(const std::string& libIn, const std::string& sha1In,
+          const std::string& kindIn = "")
+    : lib(libIn), sha1(sha1In), kind(kindIn) {}
 
   std::string lib;
   std::string sha1;
+  std::string kind;
+};
+
+struct DlopenRec
+{
+  DlopenRec(const std::string& libIn, double tOpen, double tClose, long nOpen, long nClose)
+    : lib(libIn), t_open(tOpen), t_close(tClose), nopen(nOpen), nclose(nClose) {}
+
+  std::string lib;
+  double      t_open;
+  double      t_close;
+  long        nopen;
+  long        nclose;
 };
 
 struct ProcessTree
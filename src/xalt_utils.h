@@ -11,6 +11,6 @@ FILE* xalt_json_file_open(std::string& rmapD, const char* name);
 
 void build_resultDir(std::string& resultDir,  const char *kind, const char* transmission, const char* uuid);
 void build_resultFn(std::string& resultFn, double start, const char* syshost, const char* uuid, const char *kind,
-                    const char* suffix);
+                    const char* suffix, const char* ext = ".json");
 
 #endif //XALT_UTILS_H
@@ -9,52 +9,23 @@
 
 char* compress_string(const char* str, int* lenOut)
 {
-  z_stream zs;
-  memset(&zs, 0, sizeof(zs));
-  if (deflateInit(&zs, Z_BEST_COMPRESSION) != Z_OK)
-    {
-      fprintf(stderr, "Unable to set compression level with deflateInit\n");
-      exit(1);
-    }
-
-  zs.next_in  = (Bytef *) str;
-  zs.avail_in = strlen(str);
-
-  int  ret, oldSz;
-  char outbuffer[BUFFSZ];
-
-  
-  int  szOut   = 0;
-  int  totalSz = zs.avail_in/2;
-  char *prev;
-  char *out    = (char *) malloc(totalSz+1);
+  return compress_buf(str, strlen(str), lenOut);
+}
 
-  do
+/* Like compress_string() but for len bytes that may contain NULs.  The
+ * output buffer is sized with compressBound() so zlib writes straight
+ * into it. */
+char* compress_buf(const char* str, int len, int* lenOut)
+{
+  uLongf outLen = compressBound(len);
+  char*  out    = (char *) malloc(outLen + 1);
+  if (compress2((Bytef *) out, &outLen, (const Bytef *) str, len, Z_BEST_COMPRESSION) != Z_OK)
     {
-      zs.next_out  = (Bytef *) outbuffer;
-      zs.avail_out = BUFFSZ;
-
-      ret = deflate(&zs, Z_FINISH);
-
-      oldSz = szOut;
-      szOut = zs.total_out;
-
-      if (szOut > totalSz)
-	{
-	  totalSz = MAX(2*totalSz, 2*szOut);
-	  prev    = out;
-	  out     = (char *)malloc(totalSz+1);
-	  memcpy(out, prev, oldSz);
-	  free(prev);
-	}
-      if (oldSz < szOut)
-	{
-	  memcpy(&out[oldSz], outbuffer, zs.total_out - oldSz);
-	  out[szOut] = '\0';
-	}
+      fprintf(stderr, "Unable to compress with compress2\n");
+      exit(1);
     }
-  while(ret == Z_OK);
-  *lenOut = szOut;
+  out[outLen] = '\0';
+  *lenOut     = outLen;
   return out;
 }
 
@@ -7,6 +7,7 @@ extern "C"
 #endif
 
 char* compress_string(  const char* in, int* lenOut);
+char* compress_buf(     const char* in, int  len,  int* lenOut);
 char* uncompress_string(const char* in, int  lenOut);
 
 #ifdef __cplusplus